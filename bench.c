@@ -0,0 +1,228 @@
+/**
+****************************************************************************************************************
+* IOS-projekt2, Child Care
+* @file bench.c
+* @author Jan Koci
+* @brief Microbenchmark of libchildcare.
+* @details Measures ns per participant move (one participant entering or leaving the centre) single threaded with
+	single and batched calls, and under contention with several threads sharing one centre. Every round one adult
+	enters, three children enter and leave, and the adult leaves, so no participant ever has to wait in a queue.
+	Both kinds of rounds make the same ROUND_MOVES moves, single ones with 8 calls and batched ones with 4.
+	The queue case sends every participant through a queue, in rounds: the adult thread opens a round, the
+	QUEUE_CHILDREN child threads come and wait in the child_queue as there is no adult, the adult enters (letting
+	them in) and leaves right away, waiting in the adult_queue until the children leave. Threads wait for their
+	round with sched_yield, which is not a voluntary context switch. It reports the handoff latency of both queues (post to wakeup) and
+	the voluntary context switches, build it as bench-spin to compare with spinning before blocking.
+****************************************************************************************************************
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include "childcare.h"
+
+#define ROUND_MOVES 8 // participants entering or leaving per round
+#define QUEUE_CHILDREN 3 // child threads of the queue case, as many as one adult lets in
+#define QUEUE_DIVISOR 100 // rounds of the queue case are ROUNDS / QUEUE_DIVISOR (at least 1)
+
+centre_t *centre = NULL;
+long rounds; // rounds per thread
+long stays; // rounds of the queue case
+long queue_round = 0; // last round of the queue case the adult opened
+
+/**
+* @brief returns monotonic time in ns
+*/
+static double now_ns()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+* @brief one adult and three children enter and leave with single calls
+*/
+void *single_rounds(void *arg)
+{
+	(void) arg;
+
+	for (long i = 0; i < rounds; i++)
+	{
+		enter_adult(centre);
+		for (int j = 0; j < 3; j++)
+		{
+			enter_child(centre);
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			leave_child(centre);
+		}
+		leave_adult(centre);
+	}
+	return NULL;
+}
+
+/**
+* @brief the same participants with batched calls
+*/
+void *batched_rounds(void *arg)
+{
+	(void) arg;
+
+	for (long i = 0; i < rounds; i++)
+	{
+		enter_adults(centre, 1);
+		if (try_enter_children(centre, 3) != 3)
+		{
+			fprintf(stderr, "Error: children did not get in\n");
+			exit(1);
+		}
+		leave_children(centre, 3);
+		leave_adults(centre, 1);
+	}
+	return NULL;
+}
+
+/**
+* @brief the adult of the queue case, opens a round, enters when its children are queued and leaves right away
+*/
+void *adult_stays(void *arg)
+{
+	centre_stats_t st;
+
+	for (long i = 0; i < stays; i++)
+	{
+		__atomic_store_n(&queue_round, i + 1, __ATOMIC_RELEASE);
+		do
+		{
+			sched_yield();
+			centre_stats(arg, &st);
+		} while (st.waiting < QUEUE_CHILDREN);
+		enter_adult(arg);
+		leave_adult(arg);
+	}
+	return NULL;
+}
+
+/**
+* @brief one child of the queue case, makes one stay per round
+*/
+void *child_stays(void *arg)
+{
+	for (long i = 0; i < stays; i++)
+	{
+		// the adult of the previous round has left, the child has to wait for the next one
+		while (__atomic_load_n(&queue_round, __ATOMIC_ACQUIRE) <= i)
+		{
+			sched_yield();
+		}
+		enter_child(arg);
+		leave_child(arg);
+	}
+	return NULL;
+}
+
+/**
+* @brief runs the queue case on its own centre, prints ns per move, handoff latency and context switches
+*/
+void run_queues()
+{
+	pthread_t tid[1 + QUEUE_CHILDREN];
+	struct rusage before, after;
+	centre_stats_t st;
+	centre_t *c;
+	double start, elapsed;
+	long moves = 2 * stays * (1 + QUEUE_CHILDREN);
+
+	if ((c = centre_create(NULL, NULL)) == NULL)
+	{
+		perror("centre_create");
+		exit(2);
+	}
+	getrusage(RUSAGE_SELF, &before);
+	start = now_ns();
+	for (int t = 0; t <= QUEUE_CHILDREN; t++)
+	{
+		if (pthread_create(&tid[t], NULL, t ? child_stays : adult_stays, c) != 0)
+		{
+			fprintf(stderr, "Error: unable to create thread\n");
+			exit(2);
+		}
+	}
+	for (int t = 0; t <= QUEUE_CHILDREN; t++)
+	{
+		pthread_join(tid[t], NULL);
+	}
+	elapsed = now_ns() - start;
+	getrusage(RUSAGE_SELF, &after);
+	centre_stats(c, &st);
+
+	printf("%-10s 1+%d threads: %7.1f ns/move, handoff A %7.0f ns (%ld) C %7.0f ns (%ld), spun %ld of %ld waits, "
+		"%.2f voluntary ctx switches/wait\n", "queues", QUEUE_CHILDREN, elapsed / moves,
+		st.handoffs[CENTRE_ADULT_QUEUE] ? (double) st.handoff_ns[CENTRE_ADULT_QUEUE] / st.handoffs[CENTRE_ADULT_QUEUE] : 0.0,
+		st.handoffs[CENTRE_ADULT_QUEUE],
+		st.handoffs[CENTRE_CHILD_QUEUE] ? (double) st.handoff_ns[CENTRE_CHILD_QUEUE] / st.handoffs[CENTRE_CHILD_QUEUE] : 0.0,
+		st.handoffs[CENTRE_CHILD_QUEUE],
+		st.spun[CENTRE_ADULT_QUEUE] + st.spun[CENTRE_CHILD_QUEUE], st.waits[CENTRE_ADULT_QUEUE] + st.waits[CENTRE_CHILD_QUEUE],
+		(double) (after.ru_nvcsw - before.ru_nvcsw) / (st.waits[CENTRE_ADULT_QUEUE] + st.waits[CENTRE_CHILD_QUEUE]));
+	centre_destroy(c);
+}
+
+/**
+* @brief runs the rounds in the given number of threads and prints ns per participant move
+*/
+void run(const char *name, void *(*rounds_fn)(void *), int threads)
+{
+	pthread_t tid[threads];
+	double start, elapsed;
+
+	start = now_ns();
+	for (int t = 0; t < threads; t++)
+	{
+		if (pthread_create(&tid[t], NULL, rounds_fn, NULL) != 0)
+		{
+			fprintf(stderr, "Error: unable to create thread\n");
+			exit(2);
+		}
+	}
+	for (int t = 0; t < threads; t++)
+	{
+		pthread_join(tid[t], NULL);
+	}
+	elapsed = now_ns() - start;
+
+	printf("%-10s %2d threads: %7.1f ns/move, %7.1f ns/move per thread, %6.2f Mmoves/s\n", name, threads,
+		elapsed / (rounds * ROUND_MOVES * threads), elapsed / (rounds * ROUND_MOVES),
+		rounds * ROUND_MOVES * threads / elapsed * 1e3);
+}
+
+int main(int argc, char **argv)
+{
+	int threads = (argc > 1) ? atoi(argv[1]) : 4;
+
+	rounds = (argc > 2) ? atol(argv[2]) : 1000000;
+	stays = (rounds / QUEUE_DIVISOR > 0) ? rounds / QUEUE_DIVISOR : 1;
+	if ((threads < 1) || (rounds < 1))
+	{
+		fprintf(stderr, "Run the program with these arguments:\n\t$ ./bench [THREADS] [ROUNDS]\n");
+		exit(1);
+	}
+	if ((centre = centre_create(NULL, NULL)) == NULL)
+	{
+		perror("centre_create");
+		exit(2);
+	}
+
+	run("single", single_rounds, 1);
+	run("batched", batched_rounds, 1);
+	run("single", single_rounds, threads);
+	run("batched", batched_rounds, threads);
+	run_queues();
+
+	centre_destroy(centre);
+	return 0;
+}
@@ -0,0 +1,531 @@
+/**
+****************************************************************************************************************
+* IOS-projekt2, Child Care
+* @file childcare.c
+* @author Jan Koci
+* @brief Library implementing the admission control of the Child Care centre.
+* @details Children may enter while there are less than three of them per adult present, otherwise they wait
+	in the child_queue until an adult comes or until the child day is declared (no more adults will come, children
+	enter with no rules). Adults enter at any time and may leave only when the children left behind still have
+	enough adults, otherwise they wait in the adult_queue until enough children leave. Every change of the centre
+	is done under one semaphore, waiting participants are let in or out in batches by whoever makes room for them.
+	The centre is placed in a shared memory segment with process shared semaphores, the same handle works for
+	threads and for forked processes.
+****************************************************************************************************************
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/types.h>
+#include <sys/shm.h>
+#include "childcare.h"
+
+// Adaptive waiting on the queues, off by default (always blocks in sem_wait), build with -DSPIN_MAX_NS=50000 to spin.
+// It pays off only with idle cpus, compare with ./bench and ./bench-spin on the target machine before enabling it.
+#ifndef SPIN_MAX_NS
+#define SPIN_MAX_NS 0 // longest spin before parking in the kernel
+#endif
+#define SPIN_MIN_NS 2000 // shortest spin, lets the estimate recover after long waits
+
+/**
+* mutex = guards all fields below and serializes calls of the hook
+* child_queue = children waiting for an adult to come
+* adult_queue = adults waiting for some children to leave
+* adults, children = number of adults and children at the centre, including the ones let in or out
+	by another participant which did not wake up yet
+* leaving = number of adults waiting in the adult_queue
+* waiting = number of children waiting in the child_queue
+* child_day = is "1" when no more adults will come and so children can enter with no rules
+* posted = CLOCK_MONOTONIC time (ns) of the last post to each queue
+* latency = moving average of recent handoff latencies (post to wakeup) of both queues (ns), sets the spin budget
+* spinning = number of participants spinning right now, spinning stops when there is no idle cpu left
+*/
+struct centre
+{
+	sem_t mutex;
+	sem_t child_queue;
+	sem_t adult_queue;
+	int adults;
+	int children;
+	int leaving;
+	int waiting;
+	int child_day;
+	centre_hook_t hook;
+	void *arg;
+	int ncpu;
+	long posted[2];
+	long latency[2];
+	int spinning;
+	centre_stats_t stats;
+	pid_t creator;
+};
+
+/**
+* @brief returns CLOCK_MONOTONIC time in ns
+*/
+static long monotonic_ns()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/**
+* @brief calls the hook of the centre, caller holds the mutex
+*/
+static void emit(centre_t *c, char kind, int event, int count)
+{
+	centre_event_t ev;
+
+	if (c->hook)
+	{
+		ev.kind = kind;
+		ev.event = event;
+		ev.count = count;
+		ev.adults = c->adults;
+		ev.children = c->children;
+		c->hook(c->arg, &ev);
+	}
+}
+
+/**
+* @brief records the depth of a queue participants just joined, caller holds the mutex
+*/
+static void queue_depth(centre_t *c, int q, int depth)
+{
+	c->stats.depth_sum[q] += depth;
+	c->stats.depth_max[q] = (depth > c->stats.depth_max[q]) ? depth : c->stats.depth_max[q];
+	c->stats.queued[q] += 1;
+}
+
+/**
+* @brief lets in as many children from the child_queue as the adults present allow, caller holds the mutex
+*/
+static void admit_children(centre_t *c)
+{
+	int n;
+
+	n = c->child_day ? c->waiting : 3 * c->adults - c->children;
+	n = (n < c->waiting) ? n : c->waiting;
+	if (n > 0)
+	{
+		__atomic_store_n(&c->posted[CENTRE_CHILD_QUEUE], monotonic_ns(), __ATOMIC_RELAXED);
+		for (int i = 0; i < n; i++)
+		{
+			sem_post(&c->child_queue);
+		}
+		c->children += n;
+		c->waiting -= n;
+	}
+}
+
+/**
+* @brief lets out all adults from the adult_queue whose leaving keeps the rules of the centre, in one batch
+* @details Caller holds the mutex. k adults can leave as long as children <= 3 * (adults - k).
+*/
+static void release_adults(centre_t *c)
+{
+	int n;
+
+	n = c->adults - (c->children + 2) / 3;
+	n = (n < c->leaving) ? n : c->leaving;
+	if (n > 0)
+	{
+		__atomic_store_n(&c->posted[CENTRE_ADULT_QUEUE], monotonic_ns(), __ATOMIC_RELAXED);
+		for (int i = 0; i < n; i++)
+		{
+			sem_post(&c->adult_queue);
+		}
+		c->leaving -= n;
+		c->adults -= n;
+	}
+}
+
+/**
+* @brief waits on one of the queues, spins before parking in the kernel
+* @details A sem_wait on a queue costs a sleep, a wakeup and a reschedule. The participant first polls the semaphore
+	with sem_trywait for twice the recent handoff latency of the queue, the time from the post which let a waiter
+	go to the moment the waiter runs (bounded by SPIN_MIN_NS and SPIN_MAX_NS), and only then blocks. The handoff
+	latency is what blocking costs, not how long the queue is waited on, which for children is until an adult comes.
+	It does not spin at all when the recent latency is beyond SPIN_MAX_NS (always with the default of 0) or when
+	every cpu already has a spinner.
+* @param q = CENTRE_CHILD_QUEUE or CENTRE_ADULT_QUEUE
+* @param abstime = CLOCK_REALTIME deadline of the wait, NULL waits forever
+* @return 0, -1 with errno of sem_timedwait (ETIMEDOUT when the deadline passed, EINVAL for a bad deadline)
+*/
+static int queue_wait(centre_t *c, sem_t *queue, int q, const struct timespec *abstime)
+{
+	struct timespec start, now;
+	long latency, budget, waited, handoff;
+	int spun = 0, rc = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	latency = __atomic_load_n(&c->latency[q], __ATOMIC_RELAXED);
+	if ((latency < SPIN_MAX_NS) && (__atomic_add_fetch(&c->spinning, 1, __ATOMIC_RELAXED) < c->ncpu))
+	{
+		budget = (2 * latency < SPIN_MIN_NS) ? SPIN_MIN_NS : 2 * latency;
+		budget = (budget > SPIN_MAX_NS) ? SPIN_MAX_NS : budget;
+		for (int i = 1; !spun; i++)
+		{
+			if (sem_trywait(queue) == 0)
+			{
+				spun = 1;
+			}
+			else if ((i % 16) == 0)
+			{
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				if ((now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec) > budget)
+				{
+					break;
+				}
+			}
+			else
+			{
+#if defined(__x86_64__) || defined(__i386__)
+				__builtin_ia32_pause();
+#elif defined(__aarch64__)
+				__asm__ __volatile__("yield");
+#endif
+			}
+		}
+		__atomic_sub_fetch(&c->spinning, 1, __ATOMIC_RELAXED);
+	}
+	else if (latency < SPIN_MAX_NS)
+	{
+		// no idle cpu left to spin on
+		__atomic_sub_fetch(&c->spinning, 1, __ATOMIC_RELAXED);
+	}
+
+	while (!spun && ((rc = abstime ? sem_timedwait(queue, abstime) : sem_wait(queue)) != 0) && (errno == EINTR))
+	{
+		;
+	}
+	if (rc != 0)
+	{
+		return -1;
+	}
+
+	// moving average over the last ~8 handoffs, races between updates only lose a sample
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	waited = (now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec);
+	handoff = now.tv_sec * 1000000000L + now.tv_nsec - __atomic_load_n(&c->posted[q], __ATOMIC_RELAXED);
+	// a later post to the queue may already be recorded, the sample is then lost
+	if ((handoff >= 0) && (handoff <= waited))
+	{
+		__atomic_store_n(&c->latency[q], latency + (handoff - latency) / 8, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&c->stats.handoffs[q], 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&c->stats.handoff_ns[q], handoff, __ATOMIC_RELAXED);
+	}
+	__atomic_add_fetch(&c->stats.waits[q], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&c->stats.wait_ns[q], waited, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&c->stats.spun[q], spun, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/**
+* @brief creates an empty centre in a new shared memory segment
+* @param hook = function called on every event of the centre (may be NULL), arg is passed to it
+* @return handle of the centre, NULL with errno on failure
+*/
+centre_t *centre_create(centre_hook_t hook, void *arg)
+{
+	centre_t *c;
+	int id;
+
+	if ((id = shmget(IPC_PRIVATE, sizeof (centre_t), IPC_CREAT | 0600)) < 0)
+	{
+		return NULL;
+	}
+	c = (centre_t *) shmat(id, NULL, 0);
+	// the segment disappears with the last process detaching from it
+	shmctl(id, IPC_RMID, NULL);
+	if (c == (void *) -1)
+	{
+		return NULL;
+	}
+
+	memset(c, 0, sizeof (centre_t));
+	if ((sem_init(&c->mutex, 1, 1) != 0) || (sem_init(&c->child_queue, 1, 0) != 0) || (sem_init(&c->adult_queue, 1, 0) != 0))
+	{
+		shmdt(c);
+		return NULL;
+	}
+	c->hook = hook;
+	c->arg = arg;
+	c->ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	c->creator = getpid();
+	return c;
+}
+
+/**
+* @brief detaches the calling process from the centre
+* @details The process which created the centre also destroys its semaphores, so it has to call this after
+	every other user of the centre is done with it.
+*/
+void centre_destroy(centre_t *c)
+{
+	if (c == NULL)
+	{
+		return;
+	}
+	if (c->creator == getpid())
+	{
+		sem_destroy(&c->mutex);
+		sem_destroy(&c->child_queue);
+		sem_destroy(&c->adult_queue);
+	}
+	shmdt(c);
+}
+
+/**
+* @brief declares the child day: no more adults will come, all waiting and future children enter with no rules
+*/
+int centre_child_day(centre_t *c)
+{
+	sem_wait(&c->mutex);
+	c->child_day = 1;
+	admit_children(c);
+	sem_post(&c->mutex);
+	return 0;
+}
+
+/**
+* @brief passes a user event (CENTRE_USER and above) to the hook, ordered with the events of the centre
+*/
+int centre_trace(centre_t *c, char kind, int event)
+{
+	sem_wait(&c->mutex);
+	emit(c, kind, event, 1);
+	sem_post(&c->mutex);
+	return 0;
+}
+
+/**
+* @brief copies the statistics of the centre together with its current occupancy
+*/
+void centre_stats(centre_t *c, centre_stats_t *stats)
+{
+	sem_wait(&c->mutex);
+	*stats = c->stats;
+	stats->adults = c->adults;
+	stats->children = c->children;
+	stats->waiting = c->waiting;
+	stats->leaving = c->leaving;
+	sem_post(&c->mutex);
+}
+
+/**
+* @brief lets in up to k children without waiting
+* @return number of children which entered, 0..k, -1 with errno EINVAL when k < 1
+*/
+int try_enter_children(centre_t *c, int k)
+{
+	int n;
+
+	if (k < 1)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	sem_wait(&c->mutex);
+	// children in the child_queue go first
+	n = c->child_day ? k : (c->waiting ? 0 : 3 * c->adults - c->children);
+	n = (n < k) ? n : k;
+	n = (n > 0) ? n : 0;
+	c->children += n;
+	c->stats.arrived[CENTRE_CHILDREN] += n;
+	if (n)
+	{
+		emit(c, 'C', CENTRE_ENTER, n);
+	}
+	sem_post(&c->mutex);
+	return n;
+}
+
+/**
+* @brief lets one child in without waiting
+* @return 0, -1 with errno EAGAIN when the child would have to wait
+*/
+int try_enter_child(centre_t *c)
+{
+	if (try_enter_children(c, 1) != 1)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+* @brief lets one child in, waits in the child_queue until an adult comes or until the deadline
+* @param abstime = CLOCK_REALTIME deadline, NULL waits forever
+* @return 0, -1 with errno ETIMEDOUT when the child did not get in before the deadline, EINVAL when abstime
+	is not a valid time
+*/
+int enter_child_timed(centre_t *c, const struct timespec *abstime)
+{
+	int err;
+
+	sem_wait(&c->mutex);
+	c->stats.arrived[CENTRE_CHILDREN] += 1;
+	if (((c->children < 3 * c->adults) && !c->waiting) || c->child_day)
+	{
+		c->children += 1;
+		emit(c, 'C', CENTRE_ENTER, 1);
+		sem_post(&c->mutex);
+		return 0;
+	}
+	c->waiting += 1;
+	queue_depth(c, CENTRE_CHILD_QUEUE, c->waiting);
+	emit(c, 'C', CENTRE_WAITING, 1);
+	sem_post(&c->mutex);
+
+	if (queue_wait(c, &c->child_queue, CENTRE_CHILD_QUEUE, abstime) != 0)
+	{
+		err = errno;
+		sem_wait(&c->mutex);
+		// somebody may have let the child in right after the deadline
+		if (sem_trywait(&c->child_queue) != 0)
+		{
+			c->waiting -= 1;
+			sem_post(&c->mutex);
+			errno = err;
+			return -1;
+		}
+	}
+	else
+	{
+		sem_wait(&c->mutex);
+	}
+	emit(c, 'C', CENTRE_ENTER, 1);
+	sem_post(&c->mutex);
+	return 0;
+}
+
+/**
+* @brief lets one child in, waits in the child_queue until an adult comes
+*/
+int enter_child(centre_t *c)
+{
+	return enter_child_timed(c, NULL);
+}
+
+/**
+* @brief lets k children out, then lets out queued adults and lets in queued children the centre has room for
+* @return 0, -1 with errno EINVAL when k < 1 or there are less than k children inside
+*/
+int leave_children(centre_t *c, int k)
+{
+	sem_wait(&c->mutex);
+	if ((k < 1) || (k > c->children))
+	{
+		sem_post(&c->mutex);
+		errno = EINVAL;
+		return -1;
+	}
+	emit(c, 'C', CENTRE_TRYING_TO_LEAVE, k);
+	c->children -= k;
+	c->stats.left[CENTRE_CHILDREN] += k;
+	release_adults(c);
+	admit_children(c);
+	emit(c, 'C', CENTRE_LEAVE, k);
+	sem_post(&c->mutex);
+	return 0;
+}
+
+/**
+* @brief lets one child out
+*/
+int leave_child(centre_t *c)
+{
+	return leave_children(c, 1);
+}
+
+/**
+* @brief lets k adults in, they let in waiting children and let out waiting adults they can replace
+* @return 0, -1 with errno EINVAL when k < 1
+*/
+int enter_adults(centre_t *c, int k)
+{
+	if (k < 1)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	sem_wait(&c->mutex);
+	c->adults += k;
+	c->stats.arrived[CENTRE_ADULTS] += k;
+	emit(c, 'A', CENTRE_ENTER, k);
+	admit_children(c);
+	release_adults(c);
+	sem_post(&c->mutex);
+	return 0;
+}
+
+/**
+* @brief lets one adult in
+*/
+int enter_adult(centre_t *c)
+{
+	return enter_adults(c, 1);
+}
+
+/**
+* @brief lets k adults out, the ones whose leaving would break the rules wait in the adult_queue
+* @details Returns when all k adults left.
+* @return 0, -1 with errno EINVAL when k < 1 or there are less than k adults inside
+*/
+int leave_adults(centre_t *c, int k)
+{
+	int n;
+
+	sem_wait(&c->mutex);
+	if ((k < 1) || (k > c->adults))
+	{
+		sem_post(&c->mutex);
+		errno = EINVAL;
+		return -1;
+	}
+	emit(c, 'A', CENTRE_TRYING_TO_LEAVE, k);
+	n = c->adults - (c->children + 2) / 3;
+	n = (n < k) ? n : k;
+	n = (n > 0) ? n : 0;
+	c->adults -= n;
+	c->stats.left[CENTRE_ADULTS] += n;
+	if (n)
+	{
+		emit(c, 'A', CENTRE_LEAVE, n);
+	}
+	if (n == k)
+	{
+		sem_post(&c->mutex);
+		return 0;
+	}
+
+	// the rest waits for children to leave, whoever lets them out counts them as gone
+	c->leaving += k - n;
+	queue_depth(c, CENTRE_ADULT_QUEUE, c->leaving);
+	emit(c, 'A', CENTRE_WAITING, k - n);
+	sem_post(&c->mutex);
+	for (int i = n; i < k; i++)
+	{
+		queue_wait(c, &c->adult_queue, CENTRE_ADULT_QUEUE, NULL);
+	}
+
+	sem_wait(&c->mutex);
+	c->stats.left[CENTRE_ADULTS] += k - n;
+	emit(c, 'A', CENTRE_LEAVE, k - n);
+	sem_post(&c->mutex);
+	return 0;
+}
+
+/**
+* @brief lets one adult out, waits in the adult_queue while the children need the adult
+*/
+int leave_adult(centre_t *c)
+{
+	return leave_adults(c, 1);
+}
@@ -0,0 +1,87 @@
+#ifndef CHILDCARE_H
+#define CHILDCARE_H
+
+#include <time.h>
+
+/**
+* Admission control of the Child Care centre: there is always one adult present for every three children.
+* A centre lives in shared memory, so one handle can be used by threads of a process and by processes forked
+* after centre_create(). All functions return 0 (or a count) on success and -1 with errno on failure.
+*/
+typedef struct centre centre_t;
+
+// Events passed to the hook, always with the lock of the centre held
+#define CENTRE_ENTER 0
+#define CENTRE_WAITING 1
+#define CENTRE_TRYING_TO_LEAVE 2
+#define CENTRE_LEAVE 3
+#define CENTRE_USER 16 // first event number free for centre_trace()
+
+/**
+* kind = 'A' for adults, 'C' for children
+* count = number of participants in a batched call, 1 otherwise
+* adults, children = number of adults and children at the centre after the event
+*/
+typedef struct
+{
+	char kind;
+	int event;
+	int count;
+	int adults;
+	int children;
+} centre_event_t;
+
+typedef void (*centre_hook_t)(void *arg, const centre_event_t *event);
+
+// Indexes of the queues and of the kinds of participants in centre_stats_t
+#define CENTRE_CHILD_QUEUE 0
+#define CENTRE_ADULT_QUEUE 1
+#define CENTRE_CHILDREN 0
+#define CENTRE_ADULTS 1
+
+/**
+* Statistics of the centre, one entry per queue or kind of participants
+* waits, wait_ns, spun = completed waits, their total time and how many ended while spinning
+* handoffs, handoff_ns = measured handoffs (post to wakeup of the waiter) and their total time
+* queued, depth_sum, depth_max = depth of the queue seen by every joining participant
+* arrived, left = participants which came to the centre and which left it
+* adults, children, waiting, leaving = occupancy of the centre and of the queues at the time of the call
+*/
+typedef struct
+{
+	long waits[2];
+	long wait_ns[2];
+	long spun[2];
+	long handoffs[2];
+	long handoff_ns[2];
+	long queued[2];
+	long depth_sum[2];
+	long depth_max[2];
+	long arrived[2];
+	long left[2];
+	int adults;
+	int children;
+	int waiting;
+	int leaving;
+} centre_stats_t;
+
+// Documentation in source file
+centre_t *centre_create(centre_hook_t hook, void *arg);
+void centre_destroy(centre_t *c);
+int centre_child_day(centre_t *c);
+int centre_trace(centre_t *c, char kind, int event);
+void centre_stats(centre_t *c, centre_stats_t *stats);
+
+int try_enter_child(centre_t *c);
+int enter_child(centre_t *c);
+int enter_child_timed(centre_t *c, const struct timespec *abstime);
+int leave_child(centre_t *c);
+int enter_adult(centre_t *c);
+int leave_adult(centre_t *c);
+
+int try_enter_children(centre_t *c, int k);
+int leave_children(centre_t *c, int k);
+int enter_adults(centre_t *c, int k);
+int leave_adults(centre_t *c, int k);
+
+#endif // CHILDCARE_H
@@ -0,0 +1,981 @@
+/**
+****************************************************************************************************************
+* IOS-projekt2, Child Care
+* @file explore.c
+* @author Jan Koci
+* @brief Systematic interleaving explorer for the child/adult protocol of proj2.c.
+* @details The real libchildcare (childcare.c, built into this file with SPIN_MAX_NS 0) runs under a deterministic
+	scheduler instead of fork() and the kernel. Every participant is a coroutine with its own stack running child()
+	or adult() of participants.c, the code of the proj2 processes, and the semaphore calls of the library and of the
+	participants go to the scheduler, which stops the participant at every sem_wait and sem_timedwait and picks who
+	runs next.
+	A depth first search visits every interleaving of these steps, with three reductions:
+	- atomic blocks = a participant runs from one wait to the next without being interrupted, a wait on a lock
+	(semaphore created with value 1) while holding another lock does not stop it, posts and sem_trywait never do.
+	As the locks guard all shared data, other participants cannot tell these runs from any interleaving of them,
+	- state hashing = the state (centre, shared variables of proj2, semaphores and the used part of every stack,
+	pointers into the stack made relative, the stack below the participants cleared before every call they make)
+	is stored as a 128 bit hash and expanded only once,
+	- symmetry = states differing only in the order of the children (or of the adults) are stored once.
+	A timed wait is always enabled and times out when its semaphore is 0; a timeout while the semaphore is not 0
+	is the same run as a timeout taken before the post. Every reachable state is checked for
+	- deadlock = no participant can make a step but some have not finished,
+	- rule violation = more than three children per adult inside the centre while some adult has not left yet,
+	or a negative count in the centre.
+	The first error is reported together with its schedule (list of participant slots, adults first, then
+	children), which can be passed back with -r to print the run step by step.
+****************************************************************************************************************
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <semaphore.h>
+#include <ucontext.h>
+#include "explore.h"
+#include "perf.h"
+
+// stack pointer of a stopped participant, the stack below it is not in use
+#if defined(__x86_64__)
+#define SAVED_SP(ctx) ((uintptr_t) (ctx)->uc_mcontext.gregs[REG_RSP])
+#elif defined(__aarch64__)
+#define SAVED_SP(ctx) ((uintptr_t) (ctx)->uc_mcontext.sp)
+#else
+#error "explore needs the stack pointer saved in ucontext_t, add it for this architecture"
+#endif
+
+// part of the stack below the stack pointer which is cleared before a participant runs, keeps new frames
+// (padding and unused slots) independent of the runs explored before
+#define STACK_CLEAR 4096
+
+int adult_count; // number of modelled adult processes
+int child_count; // number of modelled child processes
+int total; // adult_count + child_count
+int per = 1; // participants per process, 2 with -b
+int batched = 0; // -b, processes come in pairs and use the batched calls
+int timed = 0; // -t, children give up waiting with enter_child_timed
+int verbose = 0; // prints the events of the centre during a replay
+
+// participants and the scheduler
+proc_t procs[MAX_PROCS];
+char stacks[MAX_PROCS][STACK_SIZE] __attribute__((aligned(16)));
+ucontext_t sched_ctx;
+int current = -1; // running participant, -1 is the scheduler
+sem_t *locks[4]; // semaphores created with value 1
+int nlocks = 0;
+
+// shared state, the variables of proj2 participants.c uses point into glue
+centre_t *centre;
+glue_t glue;
+sem_t *mutex = &glue.mutex, *finish = &glue.finish;
+int *shm_adults_left = &glue.adults_left, *shm_sync_finish = &glue.sync_finish;
+int service_mode = 0;
+int AWT = 0, CWT = 0; // the stays take no time
+const struct timespec deadline = {0, 0};
+
+/**
+* Hash table of visited states, two words per slot, an empty slot is 0
+* memory_limit = bytes the table may take while it grows (old and new table together), -m in MB
+* out_of_memory = is "1" when the search stopped because the table was full
+*/
+uint64_t *table = NULL;
+size_t capacity = 0, used = 0;
+size_t memory_limit = 1024ul << 20;
+int out_of_memory = 0;
+
+// copies of the state along the current run, to go back after exploring one step
+typedef struct
+{
+	char *data;
+	size_t size;
+} snapshot_t;
+snapshot_t snaps[MAX_DEPTH];
+
+// schedule leading to the currently explored state
+int path[MAX_DEPTH];
+
+// statistics and error reporting
+unsigned long long states = 0, transitions = 0, revisits = 0;
+unsigned long long deadlocks = 0, violations = 0;
+int keep_going = 0; // -a, count all errors instead of stopping at the first one
+int stop = 0;
+
+//==================================== Participants ============================================
+// Built without optimization, the variables of the participants then live in their stack frames and not in
+// registers, so the used part of the stack is the whole state of a participant, and no stale values of earlier
+// calls are kept in registers saved to the stack, so participants in the same state have the same stack.
+#pragma GCC push_options
+#pragma GCC optimize ("O0")
+
+/**
+* @brief value of a semaphore, the scheduler keeps it in the first int of sem_t
+*/
+static int *value(sem_t *sem)
+{
+	return (int *) sem;
+}
+
+/**
+* @brief tells whether sem is a lock
+*/
+static int is_lock(sem_t *sem)
+{
+	for (int i = 0; i < nlocks; i++)
+	{
+		if (locks[i] == sem)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+* @brief stops the running participant at an operation on sem and switches to the scheduler
+*/
+static void yield(int op, sem_t *sem)
+{
+	procs[current].op = op;
+	procs[current].sem = sem;
+	swapcontext(&procs[current].ctx, &sched_ctx);
+}
+
+/**
+* @brief counts a lock taken by the running participant
+*/
+static void take(sem_t *sem)
+{
+	*value(sem) -= 1;
+	if ((current >= 0) && is_lock(sem))
+	{
+		procs[current].locks += 1;
+	}
+}
+
+// semaphore calls of the scheduler, used by libchildcare and the participants instead of the ones of libc
+static int model_init(sem_t *sem, int pshared, unsigned int val)
+{
+	(void) pshared;
+
+	memset(sem, 0, sizeof (sem_t));
+	*value(sem) = val;
+	if ((val == 1) && (nlocks < (int) (sizeof (locks) / sizeof (locks[0]))))
+	{
+		locks[nlocks++] = sem;
+	}
+	return 0;
+}
+
+static int model_destroy(sem_t *sem)
+{
+	(void) sem;
+
+	return 0;
+}
+
+static int model_wait(sem_t *sem)
+{
+	if ((current >= 0) && (!procs[current].locks || !*value(sem)))
+	{
+		yield(OP_WAIT, sem);
+	}
+	else if (!*value(sem))
+	{
+		fprintf(stderr, "Error: the scheduler would block in sem_wait\n");
+		exit(1);
+	}
+	take(sem);
+	return 0;
+}
+
+static int model_timedwait(sem_t *sem, const struct timespec *abstime)
+{
+	(void) abstime;
+
+	if ((current >= 0) && !procs[current].locks)
+	{
+		yield(OP_TIMEDWAIT, sem);
+	}
+	if (!*value(sem))
+	{
+		errno = ETIMEDOUT;
+		return -1;
+	}
+	take(sem);
+	return 0;
+}
+
+static int model_trywait(sem_t *sem)
+{
+	if (!*value(sem))
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	take(sem);
+	return 0;
+}
+
+static int model_post(sem_t *sem)
+{
+	*value(sem) += 1;
+	if ((current >= 0) && is_lock(sem))
+	{
+		procs[current].locks -= 1;
+	}
+	return 0;
+}
+
+// time stands still, the clock must not make runs differ
+static int model_clock(clockid_t clk, struct timespec *ts)
+{
+	(void) clk;
+
+	ts->tv_sec = 0;
+	ts->tv_nsec = 0;
+	return 0;
+}
+
+#define SPIN_MAX_NS 0
+#define sem_init model_init
+#define sem_destroy model_destroy
+#define sem_wait model_wait
+#define sem_timedwait model_timedwait
+#define sem_trywait model_trywait
+#define sem_post model_post
+#define clock_gettime model_clock
+#include "childcare.c"
+#undef sem_init
+#undef sem_destroy
+#undef sem_wait
+#undef sem_timedwait
+#undef sem_trywait
+#undef sem_post
+#undef clock_gettime
+
+/**
+* @brief prints the events of the centre during a replay
+*/
+static void trace(void *arg, const centre_event_t *ev)
+{
+	static const char *names[] = {"enter", "waiting", "trying to leave", "leave"};
+
+	(void) arg;
+	if (!verbose)
+	{
+		return;
+	}
+	printf("\t\t: %c %d\t: ", ev->kind, (ev->kind == 'A') ? current + 1 : current - adult_count + 1);
+	if (ev->event == EVENT_STARTED)
+	{
+		printf("started");
+	}
+	else if (ev->event == EVENT_FINISHED)
+	{
+		printf("finished");
+	}
+	else
+	{
+		printf("%s", names[ev->event]);
+	}
+	if (ev->count > 1)
+	{
+		printf(" x%d", ev->count);
+	}
+	printf("\t(adults %d children %d)\n", ev->adults, ev->children);
+}
+
+/**
+* @brief first function of every participant
+*/
+static void start()
+{
+	if (current < adult_count)
+	{
+		adult();
+	}
+	else
+	{
+		child();
+	}
+	procs[current].done = 1;
+}
+
+/**
+* @brief arrive() of proj2.c, the identifiers only name the processes in the log and are left out
+*/
+int arrive(char kind)
+{
+	(void) kind;
+
+	return 0;
+}
+
+// perf.c is not linked, no process is sampled
+void perf_begin(int phase)
+{
+	(void) phase;
+}
+
+void perf_end(int phase)
+{
+	(void) phase;
+}
+
+/**
+* @brief clears the stack below the caller
+* @details Called by the participants before every call into the library, so that the slots the new frames do
+	not write (padding, variables set later) hold zeros and not whatever the earlier calls left there, which would
+	make states differing only in such leftovers look different.
+*/
+static void clear_stack()
+{
+	volatile char below[STACK_CLEAR];
+
+	memset((char *) below, 0, sizeof (below));
+}
+
+/**
+* @brief enter_child() of the child process, a pair of children with -b, giving up at once with -t
+* @details A pair enters together as far as the centre lets it, the rest of the pair enters one by one after that.
+	Children which wait for the rest of their pair inside the centre could keep the adults in forever, so the
+	children which got in together leave before the rest comes. The children inside are kept in procs[].inside.
+* @return 0 when some children of the process are inside, -1 when the last one gave up waiting
+*/
+static int model_enter_child(centre_t *c)
+{
+	int entered = 0;
+
+	clear_stack();
+	if (batched && ((entered = try_enter_children(c, per)) == per))
+	{
+		procs[current].inside = per;
+		return 0;
+	}
+	if (entered > 0)
+	{
+		clear_stack();
+		leave_children(c, entered);
+	}
+	for (int i = entered; i < per; i++)
+	{
+		clear_stack();
+		if ((timed ? enter_child_timed(c, &deadline) : enter_child(c)) != 0)
+		{
+			continue;
+		}
+		if (i + 1 < per)
+		{
+			clear_stack();
+			leave_child(c);
+			continue;
+		}
+		procs[current].inside = 1;
+		return 0;
+	}
+	return -1;
+}
+
+/**
+* @brief leave_child() of the child process, for the children model_enter_child() left inside
+*/
+static int model_leave_child(centre_t *c)
+{
+	int inside = procs[current].inside;
+
+	procs[current].inside = 0;
+	clear_stack();
+	return (inside > 1) ? leave_children(c, inside) : leave_child(c);
+}
+
+/**
+* @brief enter_adult() of the adult process, a pair of adults with -b
+*/
+static int model_enter_adult(centre_t *c)
+{
+	clear_stack();
+	return batched ? enter_adults(c, per) : enter_adult(c);
+}
+
+/**
+* @brief leave_adult() of the adult process, a pair of adults with -b
+*/
+static int model_leave_adult(centre_t *c)
+{
+	clear_stack();
+	return batched ? leave_adults(c, per) : leave_adult(c);
+}
+
+/**
+* @brief centre_trace() of the participants
+*/
+static int model_trace(centre_t *c, char kind, int event)
+{
+	clear_stack();
+	return centre_trace(c, kind, event);
+}
+
+/**
+* @brief sem_wait() of the participants
+*/
+static int model_lock(sem_t *sem)
+{
+	clear_stack();
+	return model_wait(sem);
+}
+
+/**
+* @brief centre_child_day() of the last adult, printed during a replay
+*/
+static int model_child_day(centre_t *c)
+{
+	if (verbose)
+	{
+		printf("\t\t: A %d\t: child day\n", current + 1);
+	}
+	clear_stack();
+	return centre_child_day(c);
+}
+
+#define sem_wait model_lock
+#define sem_post model_post
+#define centre_trace model_trace
+#define enter_child model_enter_child
+#define leave_child model_leave_child
+#define enter_adult model_enter_adult
+#define leave_adult model_leave_adult
+#define centre_child_day model_child_day
+#include "participants.c"
+#undef sem_wait
+#undef sem_post
+#undef centre_trace
+#undef enter_child
+#undef leave_child
+#undef enter_adult
+#undef leave_adult
+#undef centre_child_day
+
+#pragma GCC pop_options
+//==============================================================================================
+
+/**
+* @brief tells whether participant p can make a step
+*/
+static int enabled(int p)
+{
+	if (procs[p].done)
+	{
+		return 0;
+	}
+	return (procs[p].op == OP_TIMEDWAIT) || (*value(procs[p].sem) > 0);
+}
+
+/**
+* @brief runs participant p until it stops at its next wait or returns
+*/
+static void run(int p)
+{
+	uintptr_t sp = SAVED_SP(&procs[p].ctx);
+	uintptr_t low = (sp - (uintptr_t) stacks[p] > STACK_CLEAR) ? sp - STACK_CLEAR : (uintptr_t) stacks[p];
+
+	memset((void *) low, 0, sp - low);
+	current = p;
+	swapcontext(&sched_ctx, &procs[p].ctx);
+	current = -1;
+}
+
+/**
+* @brief creates the centre and runs every participant to its first wait
+*/
+static void setup()
+{
+	if ((centre = centre_create(trace, NULL)) == NULL)
+	{
+		perror("Error: centre_create");
+		exit(2);
+	}
+	model_init(&glue.mutex, 1, 1);
+	model_init(&glue.finish, 1, 0);
+	if (adult_count == 0)
+	{
+		centre_child_day(centre);
+	}
+
+	for (int p = 0; p < total; p++)
+	{
+		getcontext(&procs[p].ctx);
+		procs[p].ctx.uc_stack.ss_sp = stacks[p];
+		procs[p].ctx.uc_stack.ss_size = STACK_SIZE;
+		procs[p].ctx.uc_link = &sched_ctx;
+		makecontext(&procs[p].ctx, start, 0);
+		current = p;
+		swapcontext(&sched_ctx, &procs[p].ctx);
+		current = -1;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *schedule = NULL;
+	struct timespec begin, end;
+	double seconds;
+	int opt;
+
+	setbuf(stdout, NULL);
+	setbuf(stderr, NULL);
+
+	while ((opt = getopt(argc, argv, "abtm:r:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'a':
+				keep_going = 1;
+				break;
+			case 'b':
+				batched = 1;
+				per = 2;
+				break;
+			case 't':
+				timed = 1;
+				break;
+			case 'm':
+				if (atol(optarg) < 1)
+				{
+					fprintf(stderr, "Error: memory limit must be at least 1 MB.\n");
+					print_help();
+					exit(1);
+				}
+				memory_limit = (size_t) atol(optarg) << 20;
+				break;
+			case 'r':
+				schedule = optarg;
+				break;
+			default:
+				print_help();
+				exit(1);
+		}
+	}
+
+	if (argc - optind != 2)
+	{
+		fprintf(stderr, "Error: wrong arguments passed.\n");
+		print_help();
+		exit(1);
+	}
+
+	adult_count = atoi(argv[optind]);
+	child_count = atoi(argv[optind + 1]);
+	total = adult_count + child_count;
+
+	if ((adult_count < 0) || (child_count < 0) || (total > MAX_PROCS))
+	{
+		fprintf(stderr, "Error: number of adults and children must be positive and at most %d together.\n", MAX_PROCS);
+		print_help();
+		exit(1);
+	}
+
+	setup();
+	if (schedule)
+	{
+		exit(replay(schedule));
+	}
+
+	// visited states
+	capacity = 1 << 16;
+	if ((table = calloc(capacity, 2 * sizeof (uint64_t))) == NULL)
+	{
+		fprintf(stderr, "Error: cannot allocate memory\n");
+		exit(2);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	explore(0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	printf("A=%d C=%d: %llu states, %llu transitions, %llu revisits\n",
+		adult_count * per, child_count * per, states, transitions, revisits);
+	printf("%s: %llu deadlocks, %llu rule violations, %.3f s, %.0f states/s\n",
+		stop ? "stopped" : "complete", deadlocks, violations, seconds, seconds > 0 ? states / seconds : 0.0);
+	if (out_of_memory)
+	{
+		printf("memory limit of %zu MB reached with %zu states stored, raise it with -m\n", memory_limit >> 20, used);
+	}
+
+	free(table);
+	for (int i = 0; i < MAX_DEPTH; i++)
+	{
+		free(snaps[i].data);
+	}
+	centre_destroy(centre);
+	exit((deadlocks || violations) ? 3 : (out_of_memory ? 2 : 0));
+}
+
+/**
+* @brief checks the rules of the centre
+* @details The counts of the centre include children already let in and leave out adults already let out which
+	did not wake up yet, so they never show fewer children or more adults than are really inside.
+* @return description of the violation or NULL
+*/
+static const char *check()
+{
+	if ((centre->adults < 0) || (centre->children < 0) || (centre->waiting < 0) || (centre->leaving < 0))
+	{
+		return "negative count";
+	}
+	if ((centre->children > 3 * centre->adults) && (glue.adults_left < adult_count))
+	{
+		return "ratio violation";
+	}
+	return NULL;
+}
+
+/**
+* @brief prints an error found during the search together with the schedule leading to it
+*/
+static void report(const char *what, int depth)
+{
+	unsigned long long *counter = (strcmp(what, "deadlock") == 0) ? &deadlocks : &violations;
+
+	if (*counter == 0)
+	{
+		printf("%s after %d steps, replay with -r ", what, depth);
+		for (int i = 0; i < depth; i++)
+		{
+			printf("%s%d", i ? "," : "", path[i]);
+		}
+		printf("\n");
+	}
+	*counter += 1;
+	stop = !keep_going;
+}
+
+static uint64_t mix(uint64_t h, uint64_t v, uint64_t m)
+{
+	h = (h ^ v) * m;
+	return h ^ (h >> 32);
+}
+
+/**
+* @brief hashes the state of participant p into h[0], h[1]
+* @details Pointers into its own stack are made relative, so participants in the same state hash the same.
+*/
+static void hash_proc(int p, uint64_t *h)
+{
+	uintptr_t low = (uintptr_t) stacks[p], high = low + STACK_SIZE;
+	uint64_t head[] = {procs[p].done, procs[p].op, (uintptr_t) procs[p].sem, procs[p].locks, procs[p].inside};
+
+	h[0] = 0x84222325cbf29ce4ull;
+	h[1] = 0x6c62272e07bb0142ull;
+	for (size_t i = 0; i < sizeof (head) / sizeof (head[0]); i++)
+	{
+		h[0] = mix(h[0], head[i], 0x9e3779b97f4a7c15ull);
+		h[1] = mix(h[1], head[i], 0xc2b2ae3d27d4eb4full);
+	}
+	if (procs[p].done)
+	{
+		return;
+	}
+	for (const uintptr_t *w = (const uintptr_t *) SAVED_SP(&procs[p].ctx); w < (const uintptr_t *) high; w++)
+	{
+		uint64_t v = ((*w >= low) && (*w < high)) ? (*w - low) | (1ull << 63) : *w;
+
+		h[0] = mix(h[0], v, 0x9e3779b97f4a7c15ull);
+		h[1] = mix(h[1], v, 0xc2b2ae3d27d4eb4full);
+	}
+}
+
+/**
+* @brief inserts the state into the table of visited states modulo symmetry
+* @details The hashes of the adults and of the children are sorted before they are combined. The table doubles
+	when it is half full; once doubling would pass the memory limit (or fails) it is filled up to three quarters,
+	then the search stops.
+* @return 1 if the state was not visited before, 0 if it was, -1 if the table is full
+*/
+static int visit()
+{
+	uint64_t h[MAX_PROCS][2], key[2], tmp[2];
+	int shared[] = {centre->adults, centre->children, centre->leaving, centre->waiting, centre->child_day,
+		*value(&centre->mutex), *value(&centre->child_queue), *value(&centre->adult_queue),
+		glue.adults_left, glue.sync_finish, *value(&glue.mutex), *value(&glue.finish)};
+	size_t i;
+
+	for (int p = 0; p < total; p++)
+	{
+		int k = p;
+
+		hash_proc(p, tmp);
+		// insertion sort, never moves a child in front of an adult
+		while ((k > 0) && (k != adult_count) && (h[k - 1][0] > tmp[0]))
+		{
+			h[k][0] = h[k - 1][0];
+			h[k][1] = h[k - 1][1];
+			k--;
+		}
+		h[k][0] = tmp[0];
+		h[k][1] = tmp[1];
+	}
+
+	key[0] = 0x84222325cbf29ce4ull;
+	key[1] = 0x6c62272e07bb0142ull;
+	for (i = 0; i < sizeof (shared) / sizeof (shared[0]); i++)
+	{
+		key[0] = mix(key[0], shared[i], 0x9e3779b97f4a7c15ull);
+		key[1] = mix(key[1], shared[i], 0xc2b2ae3d27d4eb4full);
+	}
+	for (int p = 0; p < total; p++)
+	{
+		key[0] = mix(key[0], h[p][0], 0x9e3779b97f4a7c15ull);
+		key[1] = mix(key[1], h[p][1], 0xc2b2ae3d27d4eb4full);
+	}
+	key[0] |= 1; // an empty slot is 0
+
+	if ((2 * used >= capacity) && (3 * capacity * 2 * sizeof (uint64_t) <= memory_limit))
+	{
+		// rehash into a table twice as big
+		uint64_t *old = table;
+		size_t old_capacity = capacity;
+
+		if ((table = calloc(2 * capacity, 2 * sizeof (uint64_t))) == NULL)
+		{
+			// keep the old table, it will not grow any more
+			table = old;
+			memory_limit = 0;
+			return visit();
+		}
+		capacity *= 2;
+		for (i = 0; i < old_capacity; i++)
+		{
+			if (old[2 * i])
+			{
+				size_t j;
+
+				for (j = old[2 * i + 1] & (capacity - 1); table[2 * j]; j = (j + 1) & (capacity - 1))
+				{
+					;
+				}
+				table[2 * j] = old[2 * i];
+				table[2 * j + 1] = old[2 * i + 1];
+			}
+		}
+		free(old);
+	}
+	else if (4 * used >= 3 * capacity)
+	{
+		out_of_memory = 1;
+		stop = 1;
+		return -1;
+	}
+
+	for (i = key[1] & (capacity - 1); table[2 * i]; i = (i + 1) & (capacity - 1))
+	{
+		if ((table[2 * i] == key[0]) && (table[2 * i + 1] == key[1]))
+		{
+			return 0;
+		}
+	}
+	table[2 * i] = key[0];
+	table[2 * i + 1] = key[1];
+	used++;
+	return 1;
+}
+
+/**
+* @brief saves the centre, the shared variables of proj2 and the participants with the used part of their stacks
+*/
+static void save(snapshot_t *s)
+{
+	size_t size = sizeof (struct centre) + sizeof (glue_t) + total * sizeof (proc_t);
+	char *at;
+
+	for (int p = 0; p < total; p++)
+	{
+		size += procs[p].done ? 0 : (uintptr_t) stacks[p] + STACK_SIZE - SAVED_SP(&procs[p].ctx);
+	}
+	if (size > s->size)
+	{
+		free(s->data);
+		if ((s->data = malloc(size)) == NULL)
+		{
+			fprintf(stderr, "Error: cannot allocate memory\n");
+			exit(2);
+		}
+		s->size = size;
+	}
+
+	at = s->data;
+	memcpy(at, centre, sizeof (struct centre));
+	at += sizeof (struct centre);
+	memcpy(at, &glue, sizeof (glue_t));
+	at += sizeof (glue_t);
+	memcpy(at, procs, total * sizeof (proc_t));
+	at += total * sizeof (proc_t);
+	for (int p = 0; p < total; p++)
+	{
+		if (!procs[p].done)
+		{
+			size = (uintptr_t) stacks[p] + STACK_SIZE - SAVED_SP(&procs[p].ctx);
+			memcpy(at, (void *) SAVED_SP(&procs[p].ctx), size);
+			at += size;
+		}
+	}
+}
+
+/**
+* @brief returns to a state saved by save()
+*/
+static void restore(const snapshot_t *s)
+{
+	const char *at = s->data;
+	size_t size;
+
+	memcpy(centre, at, sizeof (struct centre));
+	at += sizeof (struct centre);
+	memcpy(&glue, at, sizeof (glue_t));
+	at += sizeof (glue_t);
+	memcpy(procs, at, total * sizeof (proc_t));
+	at += total * sizeof (proc_t);
+	for (int p = 0; p < total; p++)
+	{
+		if (!procs[p].done)
+		{
+			size = (uintptr_t) stacks[p] + STACK_SIZE - SAVED_SP(&procs[p].ctx);
+			memcpy((void *) SAVED_SP(&procs[p].ctx), at, size);
+			at += size;
+		}
+	}
+}
+
+/**
+* @brief depth first search over all interleavings of atomic blocks reachable from the current state
+*/
+void explore(int depth)
+{
+	int runnable[MAX_PROCS], n = 0, fresh;
+	const char *error;
+
+	if (stop || ((fresh = visit()) < 0))
+	{
+		return;
+	}
+	if (!fresh)
+	{
+		revisits++;
+		return;
+	}
+	states++;
+
+	for (int p = 0; p < total; p++)
+	{
+		if (enabled(p))
+		{
+			runnable[n++] = p;
+		}
+	}
+	if ((error = check()) != NULL)
+	{
+		report(error, depth);
+		return;
+	}
+	if (!n)
+	{
+		for (int p = 0; p < total; p++)
+		{
+			if (!procs[p].done)
+			{
+				report("deadlock", depth);
+				break;
+			}
+		}
+		return;
+	}
+	if (depth == MAX_DEPTH)
+	{
+		fprintf(stderr, "Error: run longer than %d steps\n", MAX_DEPTH);
+		exit(1);
+	}
+
+	save(&snaps[depth]);
+	for (int i = 0; (i < n) && !stop; i++)
+	{
+		if (i)
+		{
+			restore(&snaps[depth]);
+		}
+		run(runnable[i]);
+		transitions++;
+		path[depth] = runnable[i];
+		explore(depth + 1);
+	}
+}
+
+/**
+* @brief runs one schedule printed by the search and prints every step
+* @return 3 if the schedule ends in an error, 1 if it is not valid, 0 otherwise
+*/
+int replay(const char *schedule)
+{
+	const char *error = NULL;
+	char *end;
+	int i = 0, p, finished = 1;
+
+	verbose = 1;
+	while (*schedule)
+	{
+		p = strtol(schedule, &end, 10);
+		if ((end == schedule) || (p < 0) || (p >= total) || !enabled(p))
+		{
+			fprintf(stderr, "Error: step %d of the schedule is not a runnable participant\n", i + 1);
+			return 1;
+		}
+		schedule = (*end == ',') ? end + 1 : end;
+
+		i++;
+		printf("%d\t\t: %c %d\n", i, (p < adult_count) ? 'A' : 'C', (p < adult_count) ? p + 1 : p - adult_count + 1);
+		run(p);
+		printf("\t\t(adults %d children %d leaving %d waiting %d child_day %d adults_left %d sync_finish %d)\n",
+			centre->adults, centre->children, centre->leaving, centre->waiting, centre->child_day,
+			glue.adults_left, glue.sync_finish);
+
+		if ((error = check()) != NULL)
+		{
+			printf("%s\n", error);
+		}
+	}
+
+	for (p = 0; p < total; p++)
+	{
+		if (enabled(p))
+		{
+			return error ? 3 : 0;
+		}
+		if (!procs[p].done)
+		{
+			finished = 0;
+		}
+	}
+	if (!finished)
+	{
+		printf("deadlock\n");
+		return 3;
+	}
+	return error ? 3 : 0;
+}
+
+/**
+* @brief prints help, when wrong arguments are passed from the terminal
+*/
+void print_help()
+{
+	fprintf(stdout, "Run the program with these arguments:\n\t$ ./explore [-a] [-b] [-t] [-m MB] [-r SCHEDULE] A C\n\n \
+A = number of adult processes to model\n \
+C = number of child processes to model\n \
+-a = count all errors instead of stopping at the first one\n \
+-b = every process is a pair of participants using the batched calls (enter_adults, try_enter_children, ...)\n \
+-t = children give up waiting with enter_child_timed\n \
+-m = memory for visited states in MB (default 1024), the search stops with exit code 2 when it is used up\n \
+-r = replay SCHEDULE (comma separated participant slots, adults first) printed by a previous search\n");
+}
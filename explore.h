@@ -0,0 +1,68 @@
+#ifndef EXPLORE_H
+#define EXPLORE_H
+
+#include <stdint.h>
+#include <semaphore.h>
+#include <ucontext.h>
+#include "childcare.h"
+
+// Upper bound of modelled participants (adults + children)
+#define MAX_PROCS 24
+
+// Stack of every participant, only the part in use is saved and hashed
+#define STACK_SIZE (64 * 1024)
+
+// Upper bound of steps of one run
+#define MAX_DEPTH (MAX_PROCS * 32)
+
+// Events of proj2 passed through the centre, as in proj2.h
+#define EVENT_STARTED CENTRE_USER
+#define EVENT_FINISHED (CENTRE_USER + 1)
+
+// Operations a participant can be stopped at
+#define OP_WAIT 1 // sem_wait, enabled when the semaphore is not 0
+#define OP_TIMEDWAIT 2 // sem_timedwait, always enabled, times out when the semaphore is 0
+
+/**
+* One modelled participant of proj2, a coroutine running child() or adult() on its own stack
+* ctx = registers saved when the participant was stopped
+* sem, op = operation the participant is stopped at
+* locks = number of locks (semaphores created with value 1) the participant holds
+* done = is "1" when the participant returned
+* inside = children of the process inside the centre, kept between entering and leaving
+*/
+typedef struct
+{
+	ucontext_t ctx;
+	sem_t *sem;
+	int op;
+	int locks;
+	int done;
+	int inside;
+} proc_t;
+
+/**
+* Shared variables of proj2 the participants use besides the centre
+* mutex = mutex of proj2
+* finish = finish semaphore of proj2
+* adults_left = shm_adults_left, adult processes which left the centre
+* sync_finish = shm_sync_finish, processes which reached the finish barrier
+*/
+typedef struct
+{
+	sem_t mutex;
+	sem_t finish;
+	int adults_left;
+	int sync_finish;
+} glue_t;
+
+// Documentation in source file
+void print_help();
+void child();
+void adult();
+void finish_barrier(char kind);
+int arrive(char kind);
+void explore(int depth);
+int replay(const char *schedule);
+
+#endif // EXPLORE_H
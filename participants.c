@@ -0,0 +1,148 @@
+/**
+****************************************************************************************************************
+* IOS-projekt2, Child Care
+* @file participants.c
+* @author Jan Koci
+* @brief Child and adult processes of proj2, shared by proj2.c and explore.c.
+* @details The file is included by both programs instead of being linked, the way explore.c includes childcare.c,
+	so that the explorer runs the very code of the processes with the semaphores of its scheduler. The including
+	file provides
+	- centre, the semaphores mutex and finish, the shared counters shm_adults_left and shm_sync_finish,
+	- adult_count and child_count (processes), AWT and CWT (longest stays in ms), service_mode,
+	- arrive(kind) = names the process and tells whether it is measured with --perf,
+	- perf_begin and perf_end of perf.h.
+	The functions return when the process is done, the caller exits.
+****************************************************************************************************************
+*/
+
+/**
+* @brief function for all children 
+* @details 1. child starts -> 2. child wants to enter the centre, it has to look at the number of adults at the centre 
+	and according to that either enters of waits in the child queue until some adult enters the centre. ->
+	-> 3. child sleeps at the centre -> 4. child leaves, letting out all adults waiting in the adult_queue who
+	can leave without braking the rules of the centre -> 5. child waits for others to finish (not in service mode).
+	The rules of the centre are kept by libchildcare, which also writes the log through log_event.
+*/
+void child()
+{
+	int random_time;
+	int sampled = arrive('C'); // measured with --perf
+
+	if (sampled)
+	{
+		perf_begin(PERF_STEADY);
+	}
+	centre_trace(centre, 'C', EVENT_STARTED);
+
+	// comming to the centre, a child which gave up waiting does not stay
+	if (enter_child(centre) == 0)
+	{
+		// simulates activity at the centre
+		if (CWT > 0)
+		{
+			random_time = (random() % CWT) * 1000;
+			usleep(random_time);
+		}
+
+		leave_child(centre);
+	}
+	if (sampled)
+	{
+		perf_end(PERF_STEADY);
+	}
+	if (!service_mode)
+	{
+		if (sampled)
+		{
+			perf_begin(PERF_FINISH);
+		}
+		finish_barrier('C');
+		if (sampled)
+		{
+			perf_end(PERF_FINISH);
+		}
+	}
+}
+
+/**
+* @brief function for all adults
+* @details 1. adult starts -> 2. adult enters the centre, lets in the children waiting in the child_queue
+	the centre has room for -> 3. adult sleeps at the centre -> 4. adult trying to leave, if his exit would break
+	the rules of the centre he waits in the adult_queue for some children to leave -> 5. adult leaves and if he is
+	the last adult to leave decleres the child_day -> 6. have to wait for all other processes to leave before he
+	can finish. In service mode there is no last adult, steps 5. and 6. are left out.
+*/
+void adult()
+{
+	int random_time;
+	int sampled = arrive('A'); // measured with --perf
+	int last;
+
+	if (sampled)
+	{
+		perf_begin(PERF_STEADY);
+	}
+	centre_trace(centre, 'A', EVENT_STARTED);
+
+	// comming to the centre
+	enter_adult(centre);
+
+	// simulates his activity at the centre
+	if (AWT > 0)
+	{
+		random_time = (random() % AWT) * 1000;
+		usleep(random_time);
+	}
+
+	// wants to leave
+	leave_adult(centre);
+	// if I am the last adult to leave, all other children can wait with no rules -> child_day
+	if (!service_mode)
+	{
+		sem_wait(mutex);
+		*shm_adults_left += 1;
+		last = (*shm_adults_left == adult_count);
+		sem_post(mutex);
+		if (last)
+		{
+			centre_child_day(centre);
+		}
+	}
+	if (sampled)
+	{
+		perf_end(PERF_STEADY);
+	}
+	if (!service_mode)
+	{
+		if (sampled)
+		{
+			perf_begin(PERF_FINISH);
+		}
+		finish_barrier('A');
+		if (sampled)
+		{
+			perf_end(PERF_FINISH);
+		}
+	}
+}
+
+/**
+* @brief counts the process as left and waits for all others to leave before finishing
+* @details The last process to leave opens the finish semaphore, every finishing process passes it on.
+*/
+void finish_barrier(char kind)
+{
+	int last;
+
+	sem_wait(mutex);
+	*shm_sync_finish += 1;
+	last = (*shm_sync_finish == adult_count + child_count);
+	sem_post(mutex);
+
+	if (!last)
+	{
+		sem_wait(finish);
+	}
+	centre_trace(centre, kind, EVENT_FINISHED);
+	sem_post(finish);
+}
@@ -0,0 +1,301 @@
+/**
+****************************************************************************************************************
+* IOS-projekt2, Child Care
+* @file perf.c
+* @author Jan Koci
+* @brief Hardware and software performance counters of a run of proj2 (--perf).
+* @details Every measured process opens its own counters with perf_event_open (for the calling process only)
+	and adds the difference between perf_begin and perf_end of a phase to a table in shared memory, so the counters
+	of all forked processes are aggregated. The hardware counters are opened as one group, so they are scheduled on
+	the PMU together and cycles and instructions of the IPC always come from the same time slices. When the PMU is
+	multiplexed the group counts only part of the time, every difference is then scaled by the time the counters
+	were enabled over the time they were running, a phase in which the group never ran is left out.
+	Counters the kernel or the machine does not offer (hardware counters in most virtual machines) are left out
+	and reported as n/a. Context switches happen in the kernel and need
+	perf_event_paranoid <= 1 or CAP_PERFMON, above that page faults are counted in user space only.
+****************************************************************************************************************
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/shm.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+/**
+* Table of the counters shared by all processes
+* value = sum of the counter over all measured processes of the phase
+* runs = number of measurements of the counter in the phase, 0 when the counter is not available
+* samples = number of measured processes of the phase
+*/
+typedef struct
+{
+	long long value[PERF_PHASES][PERF_COUNTERS];
+	long runs[PERF_PHASES][PERF_COUNTERS];
+	long samples[PERF_PHASES];
+} perf_table_t;
+
+perf_table_t *perf_table = NULL;
+
+/**
+* One reading of the counters of this process
+* value = counter value
+* enabled, running = time (ns) the counter was enabled and actually counting on the PMU
+*/
+typedef struct
+{
+	long long value[PERF_COUNTERS];
+	long long enabled[PERF_COUNTERS];
+	long long running[PERF_COUNTERS];
+} perf_reading_t;
+
+// counters of this process, reopened after fork because the inherited ones count the parent
+int perf_fd[PERF_COUNTERS] = { -1, -1, -1, -1, -1 };
+int perf_leader = -1; // first opened hardware counter, the group of all hardware counters is read through it
+int perf_slot[PERF_COUNTERS]; // position in the group read of the leader, -1 for counters outside the group
+int perf_members = 0; // number of counters in the group
+perf_reading_t perf_start;
+pid_t perf_owner = 0;
+
+// type and config of every counter
+const struct
+{
+	int type;
+	int config;
+	int user; // still meaningful when counted in user space only
+	const char *name;
+} perf_events[PERF_COUNTERS] =
+{
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1, "cycles" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 1, "instructions" },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1, "cache-misses" },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, 0, "ctx-switches" },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, 1, "page-faults" },
+};
+
+const char *perf_phases[PERF_PHASES] = { "setup", "generate", "steady", "finish" };
+
+/**
+* @brief creates the shared table, enables measuring in this process and all processes forked from it
+* @return 0, -1 when the shared memory cannot be created
+*/
+int perf_init()
+{
+	int id;
+
+	if ((id = shmget(IPC_PRIVATE, sizeof (perf_table_t), IPC_CREAT | 0600)) < 0)
+	{
+		return -1;
+	}
+	perf_table = (perf_table_t *) shmat(id, NULL, 0);
+	// the segment disappears with the last process detaching from it
+	shmctl(id, IPC_RMID, NULL);
+	if (perf_table == (void *) -1)
+	{
+		perf_table = NULL;
+		return -1;
+	}
+	memset(perf_table, 0, sizeof (perf_table_t));
+	return 0;
+}
+
+/**
+* @brief opens the counters of the calling process unless it already has them
+*/
+static void perf_open()
+{
+	struct perf_event_attr attr;
+
+	if (perf_owner == getpid())
+	{
+		return;
+	}
+	for (int c = 0; c < PERF_COUNTERS; c++)
+	{
+		if (perf_fd[c] >= 0)
+		{
+			close(perf_fd[c]);
+		}
+	}
+	perf_leader = -1;
+	perf_members = 0;
+	for (int c = 0; c < PERF_COUNTERS; c++)
+	{
+		int hardware = (perf_events[c].type == PERF_TYPE_HARDWARE);
+		int group = hardware ? perf_leader : -1;
+
+		memset(&attr, 0, sizeof (attr));
+		attr.size = sizeof (attr);
+		attr.type = perf_events[c].type;
+		attr.config = perf_events[c].config;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attr.read_format |= hardware ? PERF_FORMAT_GROUP : 0;
+		// hardware events are counted in user space only, software events happen in the kernel
+		attr.exclude_kernel = hardware;
+		attr.exclude_hv = 1;
+		perf_fd[c] = syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+		if ((perf_fd[c] < 0) && (errno == EACCES) && !attr.exclude_kernel && perf_events[c].user)
+		{
+			// perf_event_paranoid >= 2 without CAP_PERFMON, only the user space part can be counted
+			attr.exclude_kernel = 1;
+			perf_fd[c] = syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+		}
+
+		perf_slot[c] = -1;
+		if ((perf_fd[c] >= 0) && hardware)
+		{
+			perf_leader = (perf_leader < 0) ? perf_fd[c] : perf_leader;
+			perf_slot[c] = perf_members++;
+		}
+	}
+	perf_owner = getpid();
+}
+
+/**
+* @brief reads all counters of the calling process, a counter which cannot be read is closed
+*/
+static void perf_read(perf_reading_t *r)
+{
+	// group read: number of counters, time enabled, time running, values in the order they joined the group
+	unsigned long long group[3 + PERF_COUNTERS], single[3];
+	int group_ok = 0;
+
+	if (perf_leader >= 0)
+	{
+		group_ok = (read(perf_leader, group, sizeof (group)) == (ssize_t) ((3 + perf_members) * sizeof (group[0])));
+	}
+	for (int c = 0; c < PERF_COUNTERS; c++)
+	{
+		if (perf_fd[c] < 0)
+		{
+			continue;
+		}
+		if ((perf_slot[c] >= 0) && group_ok)
+		{
+			r->value[c] = group[3 + perf_slot[c]];
+			r->enabled[c] = group[1];
+			r->running[c] = group[2];
+		}
+		else if ((perf_slot[c] < 0) && (read(perf_fd[c], single, sizeof (single)) == sizeof (single)))
+		{
+			r->value[c] = single[0];
+			r->enabled[c] = single[1];
+			r->running[c] = single[2];
+		}
+		else
+		{
+			close(perf_fd[c]);
+			perf_fd[c] = -1;
+		}
+	}
+}
+
+/**
+* @brief starts measuring a phase in the calling process, does nothing without --perf
+*/
+void perf_begin(int phase)
+{
+	(void) phase;
+
+	if (perf_table == NULL)
+	{
+		return;
+	}
+	perf_open();
+	perf_read(&perf_start);
+}
+
+/**
+* @brief stops measuring a phase started by perf_begin and adds the counters to the shared table
+*/
+void perf_end(int phase)
+{
+	perf_reading_t now;
+	long long running;
+
+	if (perf_table == NULL)
+	{
+		return;
+	}
+	perf_read(&now);
+	for (int c = 0; c < PERF_COUNTERS; c++)
+	{
+		// the group did not get on the PMU during the phase, there is nothing to scale
+		if ((perf_fd[c] < 0) || ((running = now.running[c] - perf_start.running[c]) <= 0))
+		{
+			continue;
+		}
+		__atomic_add_fetch(&perf_table->value[phase][c], (long long) ((double) (now.value[c] - perf_start.value[c])
+			* (now.enabled[c] - perf_start.enabled[c]) / running), __ATOMIC_RELAXED);
+		__atomic_add_fetch(&perf_table->runs[phase][c], 1, __ATOMIC_RELAXED);
+	}
+	__atomic_add_fetch(&perf_table->samples[phase], 1, __ATOMIC_RELAXED);
+}
+
+/**
+* @brief prints the table of counters per phase
+* @details Every cell is the average per measured process (scaled when the PMU was multiplexed),
+	IPC = instructions / cycles of the same group.
+*/
+void perf_report(FILE *out)
+{
+	if (perf_table == NULL)
+	{
+		return;
+	}
+	fprintf(out, "%-10s %8s", "phase", "samples");
+	for (int c = 0; c < PERF_COUNTERS; c++)
+	{
+		fprintf(out, " %14s", perf_events[c].name);
+	}
+	fprintf(out, " %6s\n", "IPC");
+
+	for (int p = 0; p < PERF_PHASES; p++)
+	{
+		fprintf(out, "%-10s %8ld", perf_phases[p], perf_table->samples[p]);
+		for (int c = 0; c < PERF_COUNTERS; c++)
+		{
+			if (perf_table->runs[p][c])
+			{
+				fprintf(out, " %14.0f", (double) perf_table->value[p][c] / perf_table->runs[p][c]);
+			}
+			else
+			{
+				fprintf(out, " %14s", "n/a");
+			}
+		}
+		if (perf_table->runs[p][PERF_CYCLES] && perf_table->runs[p][PERF_INSTRUCTIONS] && perf_table->value[p][PERF_CYCLES])
+		{
+			fprintf(out, " %6.2f\n", (double) perf_table->value[p][PERF_INSTRUCTIONS] / perf_table->value[p][PERF_CYCLES]);
+		}
+		else
+		{
+			fprintf(out, " %6s\n", "n/a");
+		}
+	}
+}
+
+/**
+* @brief closes the counters of the calling process and detaches it from the shared table
+*/
+void perf_clean()
+{
+	for (int c = 0; c < PERF_COUNTERS; c++)
+	{
+		if (perf_fd[c] >= 0)
+		{
+			close(perf_fd[c]);
+			perf_fd[c] = -1;
+		}
+	}
+	perf_leader = -1;
+	if (perf_table)
+	{
+		shmdt(perf_table);
+		perf_table = NULL;
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdio.h>
+
+// Phases of a run, rows of the table printed by perf_report
+#define PERF_SETUP 0 // set_resources() in the main process
+#define PERF_GENERATE 1 // generators forking the participants
+#define PERF_STEADY 2 // sampled participants from start until they leave the centre
+#define PERF_FINISH 3 // sampled participants in the finish barrier
+#define PERF_PHASES 4
+
+// Every PERF_SAMPLE-th participant of each kind is measured
+#define PERF_SAMPLE 4
+
+// Counters collected for every phase
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_CACHE_MISSES 2
+#define PERF_CONTEXT_SWITCHES 3
+#define PERF_PAGE_FAULTS 4
+#define PERF_COUNTERS 5
+
+// Documentation in source file
+int perf_init();
+void perf_begin(int phase);
+void perf_end(int phase);
+void perf_report(FILE *out);
+void perf_clean();
+
+#endif // PERF_H
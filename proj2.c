@@ -14,6 +14,8 @@
 */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/types.h>
@@ -22,7 +24,9 @@
 #include <sys/shm.h>
 #include <time.h>
 #include <signal.h>
+#include <sys/resource.h>
 #include "proj2.h"
+#include "perf.h"
 
 // Prototypes of functions defined below
 void print_help();
@@ -30,6 +34,16 @@ void set_resources();
 void clean_resources();
 void child();
 void adult();
+void finish_barrier(char kind);
+int arrive(char kind);
+void log_event(void *arg, const centre_event_t *ev);
+void print_stats();
+void rotate_log();
+void reopen_log(int gen);
+void on_stop(int sig);
+void service(int argc, char **argv);
+void generate(char kind, int rate);
+void print_window(long seconds, const centre_stats_t *prev, const centre_stats_t *st, const double *occupancy, long samples, int window);
 
 
 // global variables used by semaphores (read only)
@@ -38,34 +52,34 @@ int CWT; // child-work-time
 int child_count; // number of child processes to be created
 int adult_count; // number of adult processes to be created
 FILE* logfile = NULL; // output file
+int id = 0; // identifier of the participant running in this process, used by log_event
+int service_mode = 0; // --service, participants do not wait for each other, identifiers and the log rotate
+int log_gen = 0; // rotation of the log the logfile of this process belongs to
+volatile sig_atomic_t stop = 0; // set by SIGINT and SIGTERM in service mode
+
+// centre = admission control of the centre (libchildcare), writes the log through log_event
+centre_t *centre = NULL;
 
 /**
 * Posix semaphores used for synchronization
 * mutex = mutual exclusion, only one process at a time can access shared variables --> preventing race condition
-* child_queue = queue of children that want to enter, but have to wait for an adult to come
-* adult_queue = queue of adults that want to leave the centre but have to wait for some children to leave before them
-* after_you = when an adult process entered and there is a child waiting in the queue, the adult waits for the child to
-			  enter before he tries to leave
 * finish = all process have to wait for the others before they finish
 */
-sem_t* mutex = NULL, *child_queue = NULL, *adult_queue = NULL, *after_you = NULL, *finish = NULL;
+sem_t* mutex = NULL, *finish = NULL;
 
 /**
-* shm_adult = number of adults at the centre
-* shm_adultID = identifier of the shared memory segment
-* shm_child = number of children at the centre
-* shm_leaving = number of adults waiting in the adult_queue
-* shm_waiting = number of children waiting in the child_queue
 * shm_cpnum = Child Process NUMber, counts child processes
+* shm_cpnumID = identifier of the shared memory segment
 * shm_apnum = Adult Process NUMber, counts adults
-* shm_counter = counts logs written to logfile
+* shm_counter = counts logs written to logfile, only accessed from log_event (under the lock of the centre)
 * shm_sync_finish = counts processes that left the centre and wait for others to finish
-* shm_child_day = is "1" when all adults generated left the centre and so children can enter with no rules
+* shm_adults_left = counts adults that left the centre, the last one declares the child_day
+* shm_log_gen = counts rotations of the logfile, changed by log_event (under the lock of the centre), also read by
+	the generators of service mode
 */
-int *shm_adult = NULL, shm_adultID = 0, *shm_child = NULL, shm_childID = 0, \
-	*shm_leaving = NULL, shm_leavingID = 0, *shm_waiting = NULL, shm_waitingID = 0, *shm_cpnum = NULL, shm_cpnumID = 0, \
-	*shm_apnum = NULL, shm_apnumID = 0, *shm_counter = NULL, shm_counterID = 0, *shm_sync_finish = NULL, shm_sync_finishID = 0, \
-	*shm_child_day = NULL, shm_child_dayID = 0;
+int *shm_cpnum = NULL, shm_cpnumID = 0, *shm_apnum = NULL, shm_apnumID = 0, *shm_counter = NULL, shm_counterID = 0, \
+	*shm_sync_finish = NULL, shm_sync_finishID = 0, *shm_log_gen = NULL, shm_log_genID = 0, \
+	*shm_adults_left = NULL, shm_adults_leftID = 0;
 
 int main(int argc, char **argv)
 {
@@ -76,11 +90,30 @@ int main(int argc, char **argv)
 	int child_gen_time;
 	int adult_work_time;
 	int child_work_time;
+	int perf_mode = 0;
 	setbuf(stdout, NULL);
 	setbuf(stderr, NULL);
 
 //---------------------- COMMAND LINE ARGUMENTS -------------------------------------------------------------------
 
+	// optional --perf in front of the other arguments
+	if ((argc > 1) && (strcmp(argv[1], "--perf") == 0))
+	{
+		perf_mode = 1;
+		argc--;
+		argv++;
+	}
+	// --service instead of the batch arguments
+	if ((argc > 1) && (strcmp(argv[1], "--service") == 0))
+	{
+		if (perf_mode && (perf_init() != 0))
+		{
+			fprintf(stderr, "Error: cannot create shared memory for performance counters\n");
+			exit(2);
+		}
+		service(argc - 1, argv + 1);
+	}
+
 	if (argc != 7)
 	{
 		fprintf(stderr, "Error: wrong arguments passed.\n");
@@ -137,9 +170,9 @@ int main(int argc, char **argv)
 //======================================= END ARGUMENTS ===================================================================
 	
 	// open logfile
-	if ((logfile = fopen("proj2.out", "w")) == NULL)
+	if ((logfile = fopen(LOG_NAME, "w")) == NULL)
 	{
-		fprintf(stderr, "Error: cannot open file proj2.out\n");
+		fprintf(stderr, "Error: cannot open file %s\n", LOG_NAME);
 		exit(2);
 	}
 	setbuf(logfile, NULL); // for printing without buffering
@@ -148,7 +181,14 @@ int main(int argc, char **argv)
 	CWT = child_work_time;
 	srandom(time(0));
 	
+	if (perf_mode && (perf_init() != 0))
+	{
+		fprintf(stderr, "Error: cannot create shared memory for performance counters\n");
+		exit(2);
+	}
+	perf_begin(PERF_SETUP);
 	set_resources(); // creates all semaphores and shared variables
+	perf_end(PERF_SETUP);
 
 	// pids of all processes
 	pid_t adults[adult_count];
@@ -166,6 +206,7 @@ int main(int argc, char **argv)
 	else if (pid1 == 0)
 	{
 	// --- CHILD ------(generating children)----
+		perf_begin(PERF_GENERATE);
 		for (int i = 0; i < child_count; i++)
 		{
 			pid_t local_pid1;
@@ -194,6 +235,7 @@ int main(int argc, char **argv)
 			{
 			// --- CHILD -------------------- 
 				child();
+				exit(0);
 			}
 			else
 			{
@@ -201,6 +243,7 @@ int main(int argc, char **argv)
 				children[i] = local_pid1;
 			}
 		}
+		perf_end(PERF_GENERATE);
 	}
 	else
 	{
@@ -224,9 +267,10 @@ int main(int argc, char **argv)
 		else if (pid2 == 0)
 		{
 		// CHILD---------(generating adults)------
+			perf_begin(PERF_GENERATE);
 			if (adult_count == 0)
 			{
-				*shm_child_day = 1;
+				centre_child_day(centre);
 			}
 			for (int j = 0; j < adult_count; j++)
 			{
@@ -260,6 +304,7 @@ int main(int argc, char **argv)
 				{
 				// --- CHILD -----------------------
 					adult();
+					exit(0);
 				}
 				else
 				{
@@ -267,6 +312,7 @@ int main(int argc, char **argv)
 					adults[j] = local_pid2;
 				}
 			}
+			perf_end(PERF_GENERATE);
 		}
 		else
 		{
@@ -286,6 +332,15 @@ int main(int argc, char **argv)
 	waitpid(pid1, NULL, 0);
 	waitpid(pid2, NULL, 0);
 
+	// only the main process, the generators get here too
+	if ((pid1 != 0) && (pid2 != 0))
+	{
+		perf_report(stdout);
+#ifdef STATS
+		print_stats();
+#endif
+	}
+
 	// cleans semaphores and all shared variables
 	clean_resources();
 	// close logfile
@@ -294,270 +349,356 @@ int main(int argc, char **argv)
 }
 
 /**
-* @brief function for all children 
-* @details 1. child starts -> 2. child wants to enter the centre, it has to look at the number of adults at the centre 
-	and according to that either enters of waits in the child queue until some adult enters the centre. ->
-	-> 3. child sleeps at the centre -> 4. child trying to leave, looks whether there are some adults waiting
-	in the adult_queue, if so child lets the adult in, but only in case it would not brake the rules of the centre 
-	and then the child leaves, otherwise it will leave directly. -> 5. child increments the number of left processes 
-	and waits for others to finish -> 6. when child left as the last process, it indicates others they can leave.
+* @brief names the process with the next identifier of its kind, they start again from 1 in service mode
+* @return whether the process is measured with --perf
 */
-void child()
+int arrive(char kind)
 {
-	int random_time;
-	int id;
+	int *counter = (kind == 'A') ? shm_apnum : shm_cpnum;
 
 	sem_wait(mutex);
-	*shm_cpnum += 1;
-	id = *shm_cpnum;
-	fprintf(logfile, "%d\t\t: C %d\t: started\n", ++(*shm_counter), id);
+	*counter = (service_mode && (*counter == ID_ROTATE)) ? 1 : *counter + 1;
+	id = *counter;
 	sem_post(mutex);
+	return ((id - 1) % PERF_SAMPLE == 0);
+}
 
-	sem_wait(mutex);
-	// comming to the centre
-	if (( (*shm_child) < (3 * (*shm_adult)) ) || (*shm_child_day))
+// child(), adult() and finish_barrier(), the explorer runs the same code
+#include "participants.c"
+
+/**
+* @brief signal handler of service mode, asks the process to stop
+*/
+void on_stop(int sig)
+{
+	(void) sig;
+
+	stop = 1;
+}
+
+/**
+* @brief runs the centre as a long running service, never returns
+* @details Adults and children arrive open loop at a fixed rate each, no matter how long the centre keeps them,
+	and leave without waiting for anybody. The main process samples the occupancy of the centre SERVICE_TICKS times
+	a second and every N seconds prints the arrivals and departures per second, the average occupancy of the centre
+	and of both queues and the average time spent in the queues during the window. On SIGINT, SIGTERM or after
+	T seconds the generators stop, the child day lets the waiting children in and the service ends when all
+	participants left.
+* @param argv = --service AR CR AWT CWT N [T]
+*/
+void service(int argc, char **argv)
+{
+	pid_t gen[2]; // generators of children and adults
+	int rate[2], window, duration;
+	struct timespec next;
+	centre_stats_t prev, st;
+	double occupancy[4] = { 0.0 }; // children, adults, child_queue, adult_queue
+	long samples = 0, ticks = 0;
+
+	service_mode = 1;
+	if ((argc != 6) && (argc != 7))
+	{
+		fprintf(stderr, "Error: wrong arguments passed.\n");
+		print_help();
+		exit(1);
+	}
+	rate[CENTRE_ADULTS] = atoi(argv[1]);
+	rate[CENTRE_CHILDREN] = atoi(argv[2]);
+	AWT = atoi(argv[3]);
+	CWT = atoi(argv[4]);
+	window = atoi(argv[5]);
+	duration = (argc == 7) ? atoi(argv[6]) : 0;
+
+	if ((rate[CENTRE_ADULTS] < 0) || (rate[CENTRE_CHILDREN] < 0) || (rate[CENTRE_ADULTS] > 1000000) || (rate[CENTRE_CHILDREN] > 1000000))
 	{
-		*shm_child += 1;
-		fprintf(logfile, "%d\t\t: C %d\t: enter\n", ++(*shm_counter), id);
-		sem_post(mutex);
+		fprintf(stderr, "Error: arrivals of adults (AR) and children (CR) must be within 0 and 1000000 per second.\n");
+		print_help();
+		exit(1);
 	}
-	else
+	if ((AWT < 0) || (AWT >= 5001) || (CWT < 0) || (CWT >= 5001))
 	{
-		*shm_waiting += 1;
-		fprintf(logfile, "%d\t\t: C %d\t: waiting : %d : %d\n", ++(*shm_counter), id, *shm_adult, *shm_child);
-		sem_post(mutex);
-
-		sem_wait(child_queue);
-
-		sem_wait(mutex);
-		fprintf(logfile, "%d\t\t: C %d\t: enter\n", ++(*shm_counter), id);
-		sem_post(after_you);
-		sem_post(mutex);
+		fprintf(stderr, "Error: maximal time for which adult (AWT) and child (CWT) remains in the centre must be within 0 and 5001 milisecunds.\n");
+		print_help();
+		exit(1);
 	}
-	// simulates activity at the centre
-	if (CWT > 0)
+	if ((window < 1) || (duration < 0))
 	{
-		random_time = (random() % CWT) * 1000;
-		usleep(random_time);
+		fprintf(stderr, "Error: statistics window (N) must be at least 1 second and run time (T) at least 0 seconds.\n");
+		print_help();
+		exit(1);
 	}
 
-	sem_wait(mutex);
-	fprintf(logfile, "%d\t\t: C %d\t: trying to leave\n", ++(*shm_counter), id);
-	*shm_child -= 1;
+	if ((logfile = fopen(LOG_NAME, "w")) == NULL)
+	{
+		fprintf(stderr, "Error: cannot open file %s\n", LOG_NAME);
+		exit(2);
+	}
+	setbuf(logfile, NULL); // for printing without buffering
+	srandom(time(0));
+	perf_begin(PERF_SETUP);
+	set_resources();
+	perf_end(PERF_SETUP);
 
-	// if there are any processes in the adult_queue
-	if (*shm_leaving)
+	signal(SIGINT, on_stop);
+	signal(SIGTERM, on_stop);
+	for (int k = CENTRE_CHILDREN; k <= CENTRE_ADULTS; k++)
 	{
-		if ((*shm_child) <= ( 3 * ((*shm_adult) - 1)))
+		if ((gen[k] = fork()) < 0)
 		{
-			*shm_leaving -= 1;
-			*shm_adult -= 1;
-			sem_post(adult_queue);
+			fprintf(stderr, "Error: unable to fork process\n");
+			if (k == CENTRE_ADULTS)
+			{
+				kill(gen[CENTRE_CHILDREN], SIGKILL);
+			}
+			clean_resources();
+			exit(2);
+		}
+		else if (gen[k] == 0)
+		{
+			generate((k == CENTRE_ADULTS) ? 'A' : 'C', rate[k]);
 		}
 	}
-	fprintf(logfile, "%d\t\t: C %d\t: leave\n", ++(*shm_counter), id);
-	*shm_sync_finish += 1;
-	sem_post(mutex);
 
-	// if I am the last process
-	if (*shm_sync_finish == adult_count + child_count)
-	{
-		*shm_sync_finish += 1;
-		sem_post(finish);
-		sem_wait(mutex);
-		fprintf(logfile, "%d\t\t: C %d\t: finished\n", ++(*shm_counter), id);	
-		sem_post(mutex);
-	}
-	else
+	// samples the centre at absolute times, so the windows do not drift
+	centre_stats(centre, &prev);
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop)
 	{
-		sem_wait(finish);
-		sem_wait(mutex);
-		fprintf(logfile, "%d\t\t: C %d\t: finished\n", ++(*shm_counter), id);
-		sem_post(mutex);
-		sem_post(finish);
+		next.tv_nsec += 1000000000L / SERVICE_TICKS;
+		if (next.tv_nsec >= 1000000000L)
+		{
+			next.tv_sec += 1;
+			next.tv_nsec -= 1000000000L;
+		}
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) != 0)
+		{
+			continue;
+		}
+		centre_stats(centre, &st);
+		occupancy[0] += st.children;
+		occupancy[1] += st.adults;
+		occupancy[2] += st.waiting;
+		occupancy[3] += st.leaving;
+		samples++;
+		ticks++;
+		if (samples == (long) window * SERVICE_TICKS)
+		{
+			print_window(ticks / SERVICE_TICKS, &prev, &st, occupancy, samples, window);
+			prev = st;
+			samples = 0;
+			memset(occupancy, 0, sizeof (occupancy));
+		}
+		if (duration && (ticks >= (long) duration * SERVICE_TICKS))
+		{
+			stop = 1;
+		}
 	}
+
+	// no more participants come, waiting children do not need an adult any more
+	kill(gen[CENTRE_CHILDREN], SIGTERM);
+	kill(gen[CENTRE_ADULTS], SIGTERM);
+	centre_child_day(centre);
+	waitpid(gen[CENTRE_CHILDREN], NULL, 0);
+	waitpid(gen[CENTRE_ADULTS], NULL, 0);
+
+	perf_report(stdout);
+	clean_resources();
+	fclose(logfile);
 	exit(0);
 }
 
 /**
-* @brief function for all adults
-* @details 1. adult starts -> 2. adult enters the centre, looks whether there are any children waiting in the child_queue,
-	if so adult lets them in but not more than 3, then he waits for them to enter before he tries to leave, otherwise he 
-	enters directly -> 3. adult sleeps at the centre -> 4. adult trying to leave, if his exit would break the rules 
-	of the centre he waits in the adult_queue for some child to leave -> 5. adult leaves, increments the value of left
-	processes and if he is the last adult generated decleres the child_day -> 6. have to wait for all other processes 
-	to leave before he can finish, if he is the last process that left, he indicates others they can finish.
+* @brief generator of service mode, forks a participant every 1/rate seconds until stopped, never returns
+* @details Arrivals are scheduled at absolute times, a generator which falls behind (slow fork) forks the missed
+	participants at once instead of shifting the schedule, so the offered load does not depend on the centre.
+	Participants are reaped by the kernel (SIGCHLD ignored), after stopping the generator waits for all of them.
 */
-void adult()
+void generate(char kind, int rate)
 {
-	int n;
-	int random_time;
-	int id;
-
-	sem_wait(mutex);
-	*shm_apnum += 1;
-	id = *shm_apnum;
-	fprintf(logfile, "%d\t\t: A %d\t: started\n", ++(*shm_counter), id);
-	*shm_adult += 1;
-
-	// comming to the centre
-	if (*shm_waiting)
+	struct timespec next;
+	sigset_t stops, unblocked;
+	pid_t pid;
+	int gen;
+
+	signal(SIGCHLD, SIG_IGN);
+	perf_begin(PERF_GENERATE);
+	if (rate == 0)
+	{
+		// no arrivals, the stop signals stay blocked until sigsuspend so none is lost before it
+		sigemptyset(&stops);
+		sigaddset(&stops, SIGINT);
+		sigaddset(&stops, SIGTERM);
+		sigprocmask(SIG_BLOCK, &stops, &unblocked);
+		while (!stop)
+		{
+			sigsuspend(&unblocked);
+		}
+		sigprocmask(SIG_SETMASK, &unblocked, NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop && (rate > 0))
 	{
-		n = ((*shm_waiting) < 3) ? (*shm_waiting) : 3;
-		for (int i = 0; i < n; i++)
+		next.tv_nsec += 1000000000L / rate;
+		if (next.tv_nsec >= 1000000000L)
 		{
-			sem_post(child_queue);
+			next.tv_sec += next.tv_nsec / 1000000000L;
+			next.tv_nsec %= 1000000000L;
 		}
-		*shm_child += n;
-		*shm_waiting -= n;
-		fprintf(logfile, "%d\t\t: A %d\t: enter\n", ++(*shm_counter), id);
-		sem_post(mutex);
-		for (int i = 0; i < n; i++)
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) != 0)
 		{
-			sem_wait(after_you);
+			continue;
 		}
-	}
-	else
-	{
-		fprintf(logfile, "%d\t\t: A %d\t: enter\n", ++(*shm_counter), id);
-		sem_post(mutex);
-	}
-
-	// simulates his activity at the centre
-	if (AWT > 0)
-	{
-		random_time = (random() % AWT) * 1000;
-		usleep(random_time);
-	}
-
-	// wants to leave
-	sem_wait(mutex);
-	fprintf(logfile, "%d\t\t: A %d\t: trying to leave\n", ++(*shm_counter), id);
-	if ((*shm_child) <= (3 * ((*shm_adult) - 1)))
-	{
-		*shm_adult -= 1;
-	}
-	else
-	{
-		*shm_leaving += 1;
-		fprintf(logfile, "%d\t\t: A %d\t: waiting : %d : %d\n", ++(*shm_counter), id, *shm_adult, *shm_child);
-		sem_post(mutex);
-		sem_wait(adult_queue);
 
-		sem_wait(mutex);
-	}
-	fprintf(logfile, "%d\t\t: A %d\t: leave\n", ++(*shm_counter), id);
-	*shm_sync_finish += 1;
-	// if I am the last generated adult, all other children can wait with no rules -> child_day
-	if (id == adult_count)
-	{
-		*shm_child_day = 1;
-		if (*shm_waiting)
+		// a participant starts with the current logfile, instead of reopening it under the lock of the centre
+		if (log_gen != (gen = __atomic_load_n(shm_log_gen, __ATOMIC_RELAXED)))
 		{
-			n = ((*shm_waiting) < 3) ? (*shm_waiting) : 3;
-			for (int i = 0; i < n; i++)
+			reopen_log(gen);
+		}
+		if ((pid = fork()) < 0)
+		{
+			fprintf(stderr, "Error: unable to fork process\n");
+			kill(getppid(), SIGTERM);
+			break;
+		}
+		else if (pid == 0)
+		{
+			// Ctrl+C stops the generators, participants already at the centre finish their stay
+			signal(SIGINT, SIG_IGN);
+			// the generator never draws from random(), every participant would get the same times
+			srandom(time(0) ^ getpid());
+			if (kind == 'A')
 			{
-				sem_post(child_queue);
+				adult();
 			}
-			*shm_child += n;
-			*shm_waiting -= n;
+			else
+			{
+				child();
+			}
+			exit(0);
 		}
 	}
-	sem_post(mutex);
-
-	sem_wait(mutex);
-	// wait for others to leave before finishing
-	if (*shm_sync_finish == adult_count + child_count)
-	{
-		*shm_sync_finish += 1;
-		sem_post(mutex);
-		sem_post(finish);
+	perf_end(PERF_GENERATE);
 
-		sem_wait(mutex);
-		fprintf(logfile, "%d\t\t: A %d\t: finished\n", ++(*shm_counter), id);	
-		sem_post(mutex);
-	}
-	else
+	// with SIGCHLD ignored wait returns only when no participant is left
+	while ((wait(NULL) > 0) || (errno == EINTR))
 	{
-		sem_post(mutex);
-
-		sem_wait(finish);
-		sem_wait(mutex);
-		fprintf(logfile, "%d\t\t: A %d\t: finished\n", ++(*shm_counter), id);
-		sem_post(mutex);
-		sem_post(finish);
+		;
 	}
+	clean_resources();
+	fclose(logfile);
 	exit(0);
 }
 
+/**
+* @brief prints the statistics of one window of service mode
+* @param prev, st = statistics of the centre at the start and at the end of the window
+* @param occupancy = sums of the sampled children, adults, waiting children and leaving adults
+*/
+void print_window(long seconds, const centre_stats_t *prev, const centre_stats_t *st, const double *occupancy, long samples, int window)
+{
+	long waits[2], wait_ns[2];
+
+	for (int q = CENTRE_CHILD_QUEUE; q <= CENTRE_ADULT_QUEUE; q++)
+	{
+		waits[q] = st->waits[q] - prev->waits[q];
+		wait_ns[q] = st->wait_ns[q] - prev->wait_ns[q];
+	}
+	fprintf(stdout, "%ld s\t: arrived A %.1f/s C %.1f/s : left A %.1f/s C %.1f/s : inside A %.2f C %.2f : "
+		"queued A %.2f C %.2f : queue latency A %.1f us (%ld) C %.1f us (%ld)\n", seconds,
+		(double) (st->arrived[CENTRE_ADULTS] - prev->arrived[CENTRE_ADULTS]) / window,
+		(double) (st->arrived[CENTRE_CHILDREN] - prev->arrived[CENTRE_CHILDREN]) / window,
+		(double) (st->left[CENTRE_ADULTS] - prev->left[CENTRE_ADULTS]) / window,
+		(double) (st->left[CENTRE_CHILDREN] - prev->left[CENTRE_CHILDREN]) / window,
+		occupancy[1] / samples, occupancy[0] / samples, occupancy[3] / samples, occupancy[2] / samples,
+		waits[CENTRE_ADULT_QUEUE] ? wait_ns[CENTRE_ADULT_QUEUE] / 1000.0 / waits[CENTRE_ADULT_QUEUE] : 0.0, waits[CENTRE_ADULT_QUEUE],
+		waits[CENTRE_CHILD_QUEUE] ? wait_ns[CENTRE_CHILD_QUEUE] / 1000.0 / waits[CENTRE_CHILD_QUEUE] : 0.0, waits[CENTRE_CHILD_QUEUE]);
+}
 
 /**
-* @brief prepares all shared variables and semaphores
+* @brief writes one event of the centre to the logfile, called by libchildcare under the lock of the centre
 */
-void set_resources()
+void log_event(void *arg, const centre_event_t *ev)
 {
-	// Initialize shared variables
-	if ((shm_adultID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
-	{
-		perror("shmget");
-		clean_resources();
-        exit(2);
-	}
-	if ((shm_adult = (int *) shmat(shm_adultID, NULL, 0)) == NULL)
-	{
-		perror("shmget");
-		clean_resources();
-		exit(2);
+	(void) arg;
+
+	if (service_mode)
+	{
+		rotate_log();
+	}
+	switch (ev->event)
+	{
+		case EVENT_STARTED:
+			fprintf(logfile, "%d\t\t: %c %d\t: started\n", ++(*shm_counter), ev->kind, id);
+			break;
+		case CENTRE_ENTER:
+			fprintf(logfile, "%d\t\t: %c %d\t: enter\n", ++(*shm_counter), ev->kind, id);
+			break;
+		case CENTRE_WAITING:
+			fprintf(logfile, "%d\t\t: %c %d\t: waiting : %d : %d\n", ++(*shm_counter), ev->kind, id, ev->adults, ev->children);
+			break;
+		case CENTRE_TRYING_TO_LEAVE:
+			fprintf(logfile, "%d\t\t: %c %d\t: trying to leave\n", ++(*shm_counter), ev->kind, id);
+			break;
+		case CENTRE_LEAVE:
+			fprintf(logfile, "%d\t\t: %c %d\t: leave\n", ++(*shm_counter), ev->kind, id);
+			break;
+		case EVENT_FINISHED:
+			fprintf(logfile, "%d\t\t: %c %d\t: finished\n", ++(*shm_counter), ev->kind, id);
+			break;
 	}
-	else
-	{
-		*shm_adult = 0;
-	}
-	// ===========================================================================
+}
 
-	if ((shm_childID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
-	{
-		perror("shmget");
-		clean_resources();
-        exit(2);
-	}
-	if ((shm_child = (int *) shmat(shm_childID, NULL, 0)) == NULL)
+/**
+* @brief moves a full logfile to LOG_NAME.1 and reopens the logfile of this process after a rotation
+* @details Called from log_event under the lock of the centre. Every process has its own copy of logfile, a process
+	which still writes to the moved file notices the new rotation by shm_log_gen and opens LOG_NAME again. The
+	generators reopen theirs before every fork, so only participants staying over a rotation reopen it here.
+	Only the last full log is kept, so a long running service never fills the disk.
+*/
+void rotate_log()
+{
+	if (*shm_counter >= LOG_ROTATE)
 	{
-		perror("shmget");
-		clean_resources();
-		exit(2);
+		rename(LOG_NAME, LOG_NAME ".1");
+		*shm_counter = 0;
+		__atomic_add_fetch(shm_log_gen, 1, __ATOMIC_RELAXED);
 	}
-	else
+	if (log_gen != *shm_log_gen)
 	{
-		*shm_child = 0;
+		reopen_log(*shm_log_gen);
 	}
-	// ===========================================================================
+}
 
-	if ((shm_leavingID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
-	{
-		perror("shmget");
-		clean_resources();
-        exit(2);
-	}
-	if ((shm_leaving = (int *) shmat(shm_leavingID, NULL, 0)) == NULL)
-	{
-		perror("shmget");
-		clean_resources();
-		exit(2);
-	}
-	else
+/**
+* @brief opens LOG_NAME again as the logfile of this process, which belongs to rotation gen from now on
+*/
+void reopen_log(int gen)
+{
+	FILE *reopened;
+
+	// keeps writing to the moved file when the new one cannot be opened
+	if ((reopened = fopen(LOG_NAME, "a")) != NULL)
 	{
-		*shm_leaving = 0;
+		fclose(logfile);
+		logfile = reopened;
+		setbuf(logfile, NULL);
 	}
-	// ===========================================================================
+	log_gen = gen;
+}
 
-	if ((shm_waitingID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
+/**
+* @brief prepares all shared variables and semaphores
+*/
+void set_resources()
+{
+	// Initialize shared variables
+	if ((shm_cpnumID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
 	{
 		perror("shmget");
 		clean_resources();
         exit(2);
 	}
-	if ((shm_waiting = (int *) shmat(shm_waitingID, NULL, 0)) == NULL)
+	if ((shm_cpnum = (int *) shmat(shm_cpnumID, NULL, 0)) == NULL)
 	{
 		perror("shmget");
 		clean_resources();
@@ -565,17 +706,17 @@ void set_resources()
 	}
 	else
 	{
-		*shm_waiting = 0;
+		*shm_cpnum = 0;
 	}
 	// ===========================================================================
 
-	if ((shm_cpnumID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
+	if ((shm_apnumID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
 	{
 		perror("shmget");
 		clean_resources();
         exit(2);
 	}
-	if ((shm_cpnum = (int *) shmat(shm_cpnumID, NULL, 0)) == NULL)
+	if ((shm_apnum = (int *) shmat(shm_apnumID, NULL, 0)) == NULL)
 	{
 		perror("shmget");
 		clean_resources();
@@ -583,17 +724,17 @@ void set_resources()
 	}
 	else
 	{
-		*shm_cpnum = 0;
+		*shm_apnum = 0;
 	}
 	// ===========================================================================
 
-	if ((shm_apnumID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
+	if ((shm_counterID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
 	{
 		perror("shmget");
 		clean_resources();
         exit(2);
 	}
-	if ((shm_apnum = (int *) shmat(shm_apnumID, NULL, 0)) == NULL)
+	if ((shm_counter = (int *) shmat(shm_counterID, NULL, 0)) == NULL)
 	{
 		perror("shmget");
 		clean_resources();
@@ -601,17 +742,17 @@ void set_resources()
 	}
 	else
 	{
-		*shm_apnum = 0;
+		*shm_counter = 0;
 	}
 	// ===========================================================================
 
-	if ((shm_counterID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
+	if ((shm_sync_finishID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
 	{
 		perror("shmget");
 		clean_resources();
         exit(2);
 	}
-	if ((shm_counter = (int *) shmat(shm_counterID, NULL, 0)) == NULL)
+	if ((shm_sync_finish = (int *) shmat(shm_sync_finishID, NULL, 0)) == NULL)
 	{
 		perror("shmget");
 		clean_resources();
@@ -619,17 +760,17 @@ void set_resources()
 	}
 	else
 	{
-		*shm_counter = 0;
+		*shm_sync_finish = 0;
 	}
 	// ===========================================================================
 
-	if ((shm_sync_finishID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
+	if ((shm_log_genID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
 	{
 		perror("shmget");
 		clean_resources();
         exit(2);
 	}
-	if ((shm_sync_finish = (int *) shmat(shm_sync_finishID, NULL, 0)) == NULL)
+	if ((shm_log_gen = (int *) shmat(shm_log_genID, NULL, 0)) == NULL)
 	{
 		perror("shmget");
 		clean_resources();
@@ -637,17 +778,17 @@ void set_resources()
 	}
 	else
 	{
-		*shm_sync_finish = 0;
+		*shm_log_gen = 0;
 	}
 	// ===========================================================================
 
-	if ((shm_child_dayID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
+	if ((shm_adults_leftID = shmget(IPC_PRIVATE, sizeof (int), IPC_CREAT | 0666)) < 0)
 	{
 		perror("shmget");
 		clean_resources();
         exit(2);
 	}
-	if ((shm_child_day = (int *) shmat(shm_child_dayID, NULL, 0)) == NULL)
+	if ((shm_adults_left = (int *) shmat(shm_adults_leftID, NULL, 0)) == NULL)
 	{
 		perror("shmget");
 		clean_resources();
@@ -655,7 +796,7 @@ void set_resources()
 	}
 	else
 	{
-		*shm_child_day = 0;
+		*shm_adults_left = 0;
 	}
 // ===========================================================================
 	// Initialize semaphores
@@ -666,30 +807,21 @@ void set_resources()
     	perror("shmget");
     	exit(2);
     }
-    if ((adult_queue = sem_open(ADULT_QUEUE_NAME, O_CREAT | O_EXCL, 0666, 0)) == SEM_FAILED) 
-    { 
-    	clean_resources();
-    	perror("shmget");
-    	exit(2);
-    }
-    if ((child_queue = sem_open(CHILD_QUEUE_NAME, O_CREAT | O_EXCL, 0666, 0)) == SEM_FAILED) 
-    { 
-    	clean_resources();
-    	perror("shmget");
-    	exit(2);
-    }
-    if ((after_you = sem_open(AFTER_YOU_NAME, O_CREAT | O_EXCL, 0666, 0)) == SEM_FAILED) 
-    { 
-    	clean_resources();
-    	perror("shmget");
-    	exit(2);
-    }
     if ((finish = sem_open(FINISH_SEM, O_CREAT | O_EXCL, 0666, 0)) == SEM_FAILED) 
     { 
     	clean_resources();
     	perror("shmget");
     	exit(2);
     }
+// ===========================================================================
+	// Initialize the centre
+// ===========================================================================
+	if ((centre = centre_create(log_event, NULL)) == NULL)
+	{
+		perror("centre_create");
+		clean_resources();
+		exit(2);
+	}
 }
 
 /*
@@ -698,22 +830,6 @@ void set_resources()
 void clean_resources()
 {
 	// just in case it was initialized
-	if (shm_adultID)
-	{
-    	shmctl(shm_adultID, IPC_RMID, NULL);
-    }
-    if (shm_childID)
-    {
-    	shmctl(shm_childID, IPC_RMID, NULL);
-    }
-    if (shm_leavingID)
-    {
-    	shmctl(shm_leavingID, IPC_RMID, NULL);
-    }
-    if (shm_waitingID)
-    {
-    	shmctl(shm_waitingID, IPC_RMID, NULL);
-    }
     if (shm_cpnumID)
     {
     	shmctl(shm_cpnumID, IPC_RMID, NULL);
@@ -730,9 +846,13 @@ void clean_resources()
     {
     	shmctl(shm_sync_finishID, IPC_RMID, NULL);
     }
-    if (shm_child_dayID)
+    if (shm_log_genID)
+    {
+    	shmctl(shm_log_genID, IPC_RMID, NULL);
+    }
+    if (shm_adults_leftID)
     {
-    	shmctl(shm_child_dayID, IPC_RMID, NULL);
+    	shmctl(shm_adults_leftID, IPC_RMID, NULL);
     }
 
 	// Semaphores
@@ -741,40 +861,56 @@ void clean_resources()
     	sem_close(mutex);
 		sem_unlink(MUTEX_NAME);
 	}
-	if (adult_queue)
-	{
-    	sem_close(adult_queue);
-    	sem_unlink(ADULT_QUEUE_NAME);
-    }
-    if (child_queue)
-    {
-    	sem_close(child_queue);
-    	sem_unlink(CHILD_QUEUE_NAME);
-    }
-    if (after_you)
-    {
-    	sem_close(after_you);
-    	sem_unlink(AFTER_YOU_NAME);
-    }
     if (finish)
     {
     	sem_close(finish);
     	sem_unlink(FINISH_SEM);
     }
+
+	// Centre, destroyed by the main process only
+	centre_destroy(centre);
+	perf_clean();
+}
+#ifdef STATS
+/**
+* @brief prints statistics of the queues and context switches of all participants to stderr
+*/
+void print_stats()
+{
+	struct rusage usage;
+	centre_stats_t st;
+
+	getrusage(RUSAGE_CHILDREN, &usage);
+	centre_stats(centre, &st);
+	for (int q = CENTRE_CHILD_QUEUE; q <= CENTRE_ADULT_QUEUE; q++)
+	{
+		fprintf(stderr, "%s: %ld waits, %.1f us average wait, %.1f us average handoff, %ld spun, depth %.2f average %ld max\n",
+			(q == CENTRE_CHILD_QUEUE) ? "child_queue" : "adult_queue", st.waits[q],
+			st.waits[q] ? st.wait_ns[q] / 1000.0 / st.waits[q] : 0.0,
+			st.handoffs[q] ? st.handoff_ns[q] / 1000.0 / st.handoffs[q] : 0.0, st.spun[q],
+			st.queued[q] ? (double) st.depth_sum[q] / st.queued[q] : 0.0, st.depth_max[q]);
+	}
+	fprintf(stderr, "voluntary context switches: %ld, involuntary: %ld\n", usage.ru_nvcsw, usage.ru_nivcsw);
 }
+#endif
 
 /**
 * @brief prints help, when wrong arguments are passed from the terminal
 */
 void print_help()
 {
-	fprintf(stdout, "Run the program with these arguments:\n\t$ ./proj2 A C AGT CGT AWT CWT\n\n \
+	fprintf(stdout, "Run the program with these arguments:\n\t$ ./proj2 [--perf] A C AGT CGT AWT CWT\n \
+or as a long running service:\n\t$ ./proj2 [--perf] --service AR CR AWT CWT N [T]\n\n \
 A = number of adult processes to generate\n \
 C = number of child processes to generate\n \
 AGT = maximal time for generating adult process\n \
 CGT = maximal time for generating child process\n \
 AWT = maximal time for which adult remains in the centre\n \
-CWT = maximal time for which child remains in the centre\n");
+CWT = maximal time for which child remains in the centre\n \
+--perf = print performance counters of the generators and every %d. participant per phase at exit\n \
+AR, CR = adults and children arriving per second, until SIGINT or SIGTERM\n \
+N = print throughput, occupancy and queue latency of the centre every N seconds\n \
+T = stop after T seconds, 0 or none runs until stopped\n", PERF_SAMPLE);
 }
 
 
@@ -1,18 +1,37 @@
 #ifndef PROJ2_H
 #define PROJ2_H
 
+#include "childcare.h"
+
 // Documentation in source file
 void print_help();
 void set_resources();
 void clean_resources();
 void child();
 void adult();
+void finish_barrier(char kind);
+int arrive(char kind);
+void log_event(void *arg, const centre_event_t *ev);
+void print_stats();
+void rotate_log();
+void reopen_log(int gen);
+void on_stop(int sig);
+void service(int argc, char **argv);
+void generate(char kind, int rate);
+void print_window(long seconds, const centre_stats_t *prev, const centre_stats_t *st, const double *occupancy, long samples, int window);
 
 // Names of used semaphores
 #define MUTEX_NAME "/woodies_mutex"
-#define ADULT_QUEUE_NAME "/woodies_adult_queue"
-#define CHILD_QUEUE_NAME "/woodies_child_queue"
-#define AFTER_YOU_NAME "/woodies_gentle_semaphore"
 #define FINISH_SEM "/woodies_finisher"
 
+// Events of proj2 written to the log through the centre
+#define EVENT_STARTED CENTRE_USER
+#define EVENT_FINISHED (CENTRE_USER + 1)
+
+// Service mode (--service)
+#define LOG_NAME "proj2.out"
+#define LOG_ROTATE 1000000 // lines written to LOG_NAME before it is moved to LOG_NAME.1
+#define ID_ROTATE 1000000 // participants of each kind before their identifiers start again from 1
+#define SERVICE_TICKS 100 // samples of the occupancy per second
+
 #endif // PROJ2_H
\ No newline at end of file